@@ -0,0 +1,97 @@
+// alignProtocol.h - Messages between the alignment server and its clients
+//
+// cpuSmithWaterman -s <socket> serves alignments over a Unix domain socket.
+// Every message in either direction is one frame: a 4-byte length in network
+// byte order followed by that many bytes of fields, each itself a 4-byte
+// length and its bytes.
+//
+//   request:  ALIGN|SCORE  <file name 1>  <FASTA text 1>  <file name 2>  <FASTA text 2>
+//             STOP
+//   response: OK  <score>  <MSF text, for ALIGN>
+//             ERR <message>
+//
+// The file names are only used to name sequences whose FASTA header has no
+// name, as the two-file mode does.  A connection may send any number of
+// requests; each gets its response in order.  STOP makes the server finish
+// the requests it holds and exit.
+
+#ifndef ALIGN_PROTOCOL_H
+#define ALIGN_PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+// Frames larger than this are refused
+const uint32_t MAX_FRAME_BYTES = 64u << 20;
+
+// Read or write exactly n bytes, retrying after signals and short transfers
+inline bool readFully(int fd, void *buf, size_t n) {
+    char *p = static_cast<char *>(buf);
+    while(n > 0) {
+        ssize_t got = read(fd, p, n);
+        if(got < 0 && errno == EINTR) continue;
+        if(got <= 0) return false;
+        p += got;
+        n -= got;
+    }
+    return true;
+}
+
+inline bool writeFully(int fd, const void *buf, size_t n) {
+    const char *p = static_cast<const char *>(buf);
+    while(n > 0) {
+        ssize_t put = write(fd, p, n);
+        if(put < 0 && errno == EINTR) continue;
+        if(put <= 0) return false;
+        p += put;
+        n -= put;
+    }
+    return true;
+}
+
+inline void appendLength(std::string& out, uint32_t n) {
+    uint32_t be = htonl(n);
+    out.append(reinterpret_cast<const char *>(&be), 4);
+}
+
+inline bool writeFrame(int fd, const std::vector<std::string>& fields) {
+    std::string body;
+    for(const std::string& f : fields) {
+        appendLength(body, (uint32_t)f.size());
+        body += f;
+    }
+    std::string frame;
+    appendLength(frame, (uint32_t)body.size());
+    frame += body;
+    return writeFully(fd, frame.data(), frame.size());
+}
+
+// Read one frame; false at end of stream or on a malformed frame
+inline bool readFrame(int fd, std::vector<std::string>& fields) {
+    uint32_t be;
+    if(!readFully(fd, &be, 4)) return false;
+    uint32_t len = ntohl(be);
+    if(len > MAX_FRAME_BYTES) return false;
+    std::string body(len, '\0');
+    if(len > 0 && !readFully(fd, &body[0], len)) return false;
+
+    fields.clear();
+    size_t pos = 0;
+    while(pos < body.size()) {
+        if(body.size() - pos < 4) return false;
+        std::memcpy(&be, &body[pos], 4);
+        uint32_t n = ntohl(be);
+        pos += 4;
+        if(n > body.size() - pos) return false;
+        fields.push_back(body.substr(pos, n));
+        pos += n;
+    }
+    return true;
+}
+
+#endif // ALIGN_PROTOCOL_H
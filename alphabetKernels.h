@@ -0,0 +1,108 @@
+// alphabetKernels.h - Residue encodings and query profiles by alphabet
+//
+// Before a pair is aligned its alphabet is detected: DNA when both sequences
+// hold only A, C, G and T, protein when they hold only the 20 amino acids,
+// the ambiguity codes B, Z, X and the stop '*', and general otherwise.  DNA
+// and protein pairs are aligned through a query profile: seq1 is encoded as
+// symbol numbers, packed four to a byte for DNA and one to a byte for
+// protein, and for each symbol the profile holds its match or mismatch score
+// against every position of seq2, so the inner loop reads one small score
+// per cell and never compares residues.  The profile has one row per symbol,
+// 4 or 24 bytes per seq2 position, instead of one per possible byte value.
+// General pairs keep comparing bytes.
+//
+// Codes map distinct residues to distinct symbols, so equal codes mean equal
+// residues and every kernel scores exactly as the byte compare does.  The
+// profile holds scores in a signed char; scores outside its range leave the
+// pair to the byte compare too.
+
+#ifndef ALPHABET_KERNELS_H
+#define ALPHABET_KERNELS_H
+
+#include <string>
+#include <vector>
+#include <climits>
+#include <cstring>
+
+// Ordered from the narrowest alphabet; a pair takes the wider of its two
+enum SequenceAlphabet { DNA_ALPHABET, PROTEIN_ALPHABET, GENERAL_ALPHABET };
+
+struct AlphabetCodes {
+    signed char code[256];      // symbol number, or -1 outside the alphabet
+    int symbols;
+    int bits;                   // per encoded symbol: 2 up to 4 symbols, else 8
+};
+
+inline AlphabetCodes makeAlphabetCodes(const char *symbols) {
+    AlphabetCodes codes;
+    std::memset(codes.code, -1, sizeof(codes.code));
+    codes.symbols = std::strlen(symbols);
+    codes.bits = codes.symbols <= 4 ? 2 : 8;
+    for(int s = 0; s < codes.symbols; ++s) codes.code[(unsigned char)symbols[s]] = s;
+    return codes;
+}
+
+inline const AlphabetCodes& alphabetCodes(SequenceAlphabet alphabet) {
+    static const AlphabetCodes dna = makeAlphabetCodes("ACGT");
+    static const AlphabetCodes protein = makeAlphabetCodes("ARNDCQEGHILKMFPSTWYVBZX*");
+    return alphabet == DNA_ALPHABET ? dna : protein;
+}
+
+inline SequenceAlphabet detectAlphabet(const std::string& seq) {
+    const AlphabetCodes& dna = alphabetCodes(DNA_ALPHABET);
+    const AlphabetCodes& protein = alphabetCodes(PROTEIN_ALPHABET);
+    SequenceAlphabet alphabet = DNA_ALPHABET;
+    for(char c : seq) {
+        if(dna.code[(unsigned char)c] >= 0) continue;
+        if(protein.code[(unsigned char)c] < 0) return GENERAL_ALPHABET;
+        alphabet = PROTEIN_ALPHABET;
+    }
+    return alphabet;
+}
+
+inline SequenceAlphabet pairAlphabet(const std::string& seq1, const std::string& seq2) {
+    SequenceAlphabet a1 = detectAlphabet(seq1);
+    if(a1 == GENERAL_ALPHABET) return a1;
+    SequenceAlphabet a2 = detectAlphabet(seq2);
+    return a2 > a1 ? a2 : a1;
+}
+
+// Symbol numbers of a sequence known to be within the alphabet, codes.bits
+// each, the first symbol of a byte in its lowest bits
+inline void encodeSequence(const std::string& seq, const AlphabetCodes& codes,
+                           std::vector<unsigned char>& out) {
+    int perByte = 8 / codes.bits;
+    out.assign((seq.size() + perByte - 1) / perByte, 0);
+    for(size_t k = 0; k < seq.size(); ++k) {
+        out[k / perByte] |= codes.code[(unsigned char)seq[k]] << (k % perByte * codes.bits);
+    }
+}
+
+// Symbol k of a sequence encoded at bits per symbol
+inline int symbolAt(const unsigned char *encoded, size_t k, int bits) {
+    if(bits == 8) return encoded[k];
+    return (encoded[k >> 2] >> ((k & 3) * 2)) & 3;
+}
+
+// Whether a query profile can hold the match and mismatch scores
+inline bool profileHolds(int matchScore, int mismatchScore) {
+    return matchScore >= SCHAR_MIN && matchScore <= SCHAR_MAX &&
+           mismatchScore >= SCHAR_MIN && mismatchScore <= SCHAR_MAX;
+}
+
+// Row s, position j: the score of symbol s against seq[j]; the scores must
+// pass profileHolds
+inline void buildQueryProfile(const std::string& seq, const AlphabetCodes& codes,
+                              int matchScore, int mismatchScore, std::vector<signed char>& profile) {
+    size_t len = seq.size();
+    profile.resize(codes.symbols * len);
+    if(len == 0) return;
+    for(int s = 0; s < codes.symbols; ++s) {
+        signed char *row = &profile[s * len];
+        for(size_t j = 0; j < len; ++j) {
+            row[j] = codes.code[(unsigned char)seq[j]] == s ? matchScore : mismatchScore;
+        }
+    }
+}
+
+#endif // ALPHABET_KERNELS_H
@@ -24,7 +24,9 @@
 
 int SeqGCGCheckSum(char *seq, int len);
 
-ALN read_msf(FILE *fin,int nseqs);
+ALN read_msf(FILE *fin,long start,int nseqs);
+int score_aln(ALNPTR ref_aln,ALNPTR test_aln,char *refname,char *testname,char method);
+int score_manifest(char *manifest,char *testfile);
 int score_ref(int *refseq_col,int maxlen);
 int checkref(FILE *fin);
 int countmsf(FILE *fin);
@@ -56,34 +58,34 @@ Block blocks[100];
 int main(int argc, char **argv)
 {
 	FILE *ifd,*tfd,*afd;
-	int  err,i,j,ires,iseq=0;
-	int ix,n;
+	int  err,ires,iseq=0;
+	int ix;
 	int format;
 	int nseqs,refnseqs;
-	int maxlen,refmaxlen;
 	char t[MAXLINE+1];
 	char seq[MAXLINE+1];
 	char clen[MAXLINE+1];
 	char cvar[MAXLINE+1];
 	char cprog[MAXLINE+1];
 	char method;
-	Boolean eof,found;
-	int *refseq_col;
-	int *seq_xref;
-	int **seq_code,**refseq_code;
-	int tc_score;
-	float maxpc_res;
-	float pc_res;
+	Boolean eof;
 	ALN ref_aln;
 	ALN test_aln;
 
-	if(argc<3) {
+	if(argc<3 || (strcmp(argv[1],"-m")==0 && argc<4)) {
 		fprintf(stderr,"Usage: %s ref_aln test_aln [-v]\n",argv[0]);
+		fprintf(stderr,"       %s -m manifest test_alns [-v]\n",argv[0]);
 		fprintf(stderr,"                where ref_aln       reference alignment in xml/msf format \n");
 		fprintf(stderr,"                      test_aln      test alignment in msf format \n");
+		fprintf(stderr,"                      manifest      pair manifest written by splitPairs \n");
+		fprintf(stderr,"                      test_alns     test alignments for the pairs, from cpuSmithWaterman -m \n");
 		fprintf(stderr,"                      -v            verbose mode\n");
 		return 1;
 	}
+	if(strcmp(argv[1],"-m")==0) {
+		verbose=(argc==5);
+		return score_manifest(argv[2],argv[3]);
+	}
 	if(argc==4) verbose=TRUE;
 	else verbose=FALSE;
 
@@ -119,16 +121,14 @@ int main(int argc, char **argv)
 		return 1;
 	}
 	if(format==GCG) {
-		ref_aln=read_msf(ifd,refnseqs);
+		ref_aln=read_msf(ifd,0,refnseqs);
 	}
 	else if(format==XML) {
 		ref_aln=read_xml(ifd,0);
 		ref_aln.nseqs=refnseqs;
+		free_xml_parser();
 		method='B';
 	}
-	refmaxlen=0;
-	for(i=0;i<ref_aln.nseqs;i++)
-		if(refmaxlen<ref_aln.seqs[i].len) refmaxlen=ref_aln.seqs[i].len;
 
 /* read the test alignment into names, seq_array, seqlength */
 	nseqs = countmsf(tfd);
@@ -136,28 +136,120 @@ int main(int argc, char **argv)
 		fprintf(stderr,"Error: no sequences in %s\n",argv[2]);
 		return 1;
 	}
-	test_aln=read_msf(tfd,nseqs);
+	test_aln=read_msf(tfd,0,nseqs);
 
 	if(nseqs != refnseqs) {
 		fprintf(stderr,"Error: %d sequences in %s and %d in %s",refnseqs,argv[1],nseqs,argv[2]);
 		return 1;
 	}
 
+	if(score_aln(&ref_aln,&test_aln,argv[1],argv[2],method)!=0)
+		exit(1);
+
+	exit(0);
+
+	
+}
+
+/* Score every pair in a manifest written by splitPairs against the test
+alignments in testfile, which holds one record per pair as written by
+cpuSmithWaterman -m. The output for each pair is the same as a separate run
+on the pair's reference and test alignments would give. Pairs the aligner
+pruned below its --min-score are skipped, not failed. */
+int score_manifest(char *manifest,char *testfile)
+{
+	FILE *mfd,*tfd;
+	char label[MAXLINE+1];
+	char refname[FILENAMELEN+1];
+	long offset;
+	int nseqs,npairs,nfailed,npruned;
+	int ret;
+	Boolean pruned;
+	ALN ref_aln;
+	ALN test_aln;
+
+	if((mfd=fopen(manifest,"r"))==NULL) {
+		fprintf(stderr,"Cannot open manifest file [%s]",manifest);
+		return 1;
+	}
+	if((tfd=fopen(testfile,"r"))==NULL) {
+		fprintf(stderr,"Cannot open test aln file [%s]",testfile);
+		return 1;
+	}
+	if(index_test_alns(tfd,testfile)==0) {
+		fprintf(stderr,"Error: no test alignments in %s\n",testfile);
+		return 1;
+	}
+
+	npairs=nfailed=npruned=0;
+	while((ret=next_manifest_pair(mfd,label,refname,&ref_aln))>0) {
+		npairs++;
+		offset=find_test_aln(label,&pruned);
+		if(offset<0) {
+			fprintf(stderr,"Error: no test alignment for %s in %s\n",label,testfile);
+			free_aln(&ref_aln);
+			nfailed++;
+			continue;
+		}
+		if(pruned) {
+			free_aln(&ref_aln);
+			npruned++;
+			continue;
+		}
+		fseek(tfd,offset,0);
+		nseqs=countmsf(tfd);
+		if(nseqs!=ref_aln.nseqs) {
+			fprintf(stderr,"Error: %d sequences in %s and %d in %s\n",ref_aln.nseqs,refname,nseqs,label);
+			free_aln(&ref_aln);
+			nfailed++;
+			continue;
+		}
+		test_aln=read_msf(tfd,offset,nseqs);
+		if(score_aln(&ref_aln,&test_aln,refname,label,'C')!=0)
+			nfailed++;
+		free_aln(&test_aln);
+		free_aln(&ref_aln);
+	}
+	fclose(mfd);
+	fclose(tfd);
+	if(ret<0) return 1;
+	fprintf(stderr,"Scored %d of %d pairs",npairs-nfailed-npruned,npairs);
+	if(npruned>0) fprintf(stderr,", %d pruned by the aligner",npruned);
+	fprintf(stderr,"\n");
+	return nfailed>0;
+}
+
+int score_aln(ALNPTR ref_aln,ALNPTR test_aln,char *refname,char *testname,char method)
+{
+	int i,j,n;
+	int maxlen,refmaxlen;
+	Boolean found;
+	int *refseq_col;
+	int *seq_xref;
+	int **seq_code,**refseq_code;
+	int tc_score;
+	float maxpc_res;
+	float pc_res;
+
+	refmaxlen=0;
+	for(i=0;i<ref_aln->nseqs;i++)
+		if(refmaxlen<ref_aln->seqs[i].len) refmaxlen=ref_aln->seqs[i].len;
+
 	maxlen=0;
-	for(i=0;i<test_aln.nseqs;i++)
-		if(maxlen<test_aln.seqs[i].len) maxlen=test_aln.seqs[i].len;
+	for(i=0;i<test_aln->nseqs;i++)
+		if(maxlen<test_aln->seqs[i].len) maxlen=test_aln->seqs[i].len;
 
 
 
 /* cross-reference the sequence refnames, in case they're not in the same order
 in the reference and test alignment files */
-	seq_xref=(int *)ckalloc((refnseqs+2)*sizeof(int));
-	for(i=0;i<refnseqs;i++)
+	seq_xref=(int *)ckalloc((ref_aln->nseqs+2)*sizeof(int));
+	for(i=0;i<ref_aln->nseqs;i++)
 		seq_xref[i]=-1;
-	for(i=0;i<refnseqs;i++) {
+	for(i=0;i<ref_aln->nseqs;i++) {
 		found=FALSE;
-		for(j=0;j<test_aln.nseqs;j++) {
-			if(strcasecmp(test_aln.seqs[j].name,ref_aln.seqs[i].name)==0)
+		for(j=0;j<test_aln->nseqs;j++) {
+			if(strcasecmp(test_aln->seqs[j].name,ref_aln->seqs[i].name)==0)
 			{
 				found=TRUE;
 				seq_xref[j]=i;
@@ -165,17 +257,18 @@ in the reference and test alignment files */
 			}
 		}
 		if(found==FALSE) {
-			fprintf(stderr,"Error: sequence %s not found in test aln %s\n",ref_aln.seqs[i].name,argv[2]);
+			fprintf(stderr,"Error: sequence %s not found in test aln %s\n",ref_aln->seqs[i].name,testname);
+			ckfree(seq_xref);
 			return 1;
 		}
 	}
 
-        fprintf(stdout,"\nComparing test alignment in %s\nwith reference alignment in %s\n",argv[2],argv[1]);
+        fprintf(stdout,"\nComparing test alignment in %s\nwith reference alignment in %s\n",testname,refname);
 
 /* get the core blocks */
 	refseq_col=(int *)ckalloc((refmaxlen+2)*sizeof(int));
         if(method=='B') {
-                n=get_coreblocks(&ref_aln,refseq_col);
+                n=get_coreblocks(ref_aln,refseq_col);
 		if(n<0) method='C';
         }
 
@@ -183,46 +276,57 @@ in the reference and test alignment files */
 gaps. Here we use 20% of the number of sequences */
 	if(method=='C')
 	{
-        	cutoff=(float)refnseqs*20.0/100.0;
+        	cutoff=(float)ref_aln->nseqs*20.0/100.0;
         	if(cutoff<1) cutoff=1;
-        	ref_gaps(&ref_aln,refmaxlen,cutoff,refseq_col);
+        	ref_gaps(ref_aln,refmaxlen,cutoff,refseq_col);
 	}
-	if(method=='B') fprintf(stdout,"\nUsing core blocks defined in %s\n",argv[1]);
+	if(method=='B') fprintf(stdout,"\nUsing core blocks defined in %s\n",refname);
 
 /* code the reference alignment - assign to each residue the number of the column it's in 
    gap positions are coded 0 */
 
-	refseq_code=(int **)ckalloc((ref_aln.nseqs+2)*sizeof(int *));
-	for(i=0;i<ref_aln.nseqs;i++)
+	refseq_code=(int **)ckalloc((ref_aln->nseqs+2)*sizeof(int *));
+	for(i=0;i<ref_aln->nseqs;i++)
 		refseq_code[i]=(int *)ckalloc((refmaxlen+2)*sizeof(int));
-	code_refseq(&ref_aln,refmaxlen,refseq_code);
+	code_refseq(ref_aln,refmaxlen,refseq_code);
 
 
 /* calculate the max score possible ie the score for the reference alignment */
 	maxpc_res=score_ref(refseq_col,refmaxlen);
 	if(maxpc_res<=0) {
 		fprintf(stdout,"Error in reference alignment\n");
-		exit(1);
+		for(i=0;i<ref_aln->nseqs;i++)
+			ckfree(refseq_code[i]);
+		ckfree(refseq_code);
+		ckfree(refseq_col);
+		ckfree(seq_xref);
+		return 1;
 	}
 
 /* code the test alignment - look up each residue from the test alignment in the reference
 alignment and assign the reference column number */
-	seq_code=(int **)ckalloc((test_aln.nseqs+2)*sizeof(int *));
-	for(i=0;i<test_aln.nseqs;i++)
+	seq_code=(int **)ckalloc((test_aln->nseqs+2)*sizeof(int *));
+	for(i=0;i<test_aln->nseqs;i++)
 		seq_code[i]=(int *)ckalloc((maxlen+2)*sizeof(int));
-	code_seq(&ref_aln,&test_aln,seq_xref,refseq_col,refseq_code,seq_code,refmaxlen,maxlen);
+	code_seq(ref_aln,test_aln,seq_xref,refseq_col,refseq_code,seq_code,refmaxlen,maxlen);
 
 /* calculate the scores */
-	columnscore(&test_aln,test_aln.nseqs,maxlen,refseq_col,seq_code,verbose,&pc_res,&tc_score);
+	columnscore(test_aln,test_aln->nseqs,maxlen,refseq_col,seq_code,verbose,&pc_res,&tc_score);
 	pc_res/=maxpc_res;
 
         fprintf(stdout,"\n\tSP score= %.3f\n",pc_res);
         fprintf(stdout,"\n\tTC score= %.3f\n",(float)tc_score/100.0);
-fprintf(stdout,"auto %s %.3f %.3f\n",argv[2],pc_res,(float)tc_score/100.0);
-
-	exit(0);
-
-	
+fprintf(stdout,"auto %s %.3f %.3f\n",testname,pc_res,(float)tc_score/100.0);
+
+	for(i=0;i<test_aln->nseqs;i++)
+		ckfree(seq_code[i]);
+	ckfree(seq_code);
+	for(i=0;i<ref_aln->nseqs;i++)
+		ckfree(refseq_code[i]);
+	ckfree(refseq_code);
+	ckfree(refseq_col);
+	ckfree(seq_xref);
+	return 0;
 }
 
 int get_coreblocks(ALNPTR mult_aln,int *refseq_col)
@@ -443,7 +547,7 @@ void columnscore(ALNPTR test_aln,int nseqs,int seqlength,int *refseq_col,int **s
 }
 
 
-ALN read_msf(FILE *fin,int nseqs)
+ALN read_msf(FILE *fin,long start,int nseqs)
 {
         static char line[MAXLINE+1];
 	char name[MAXNAMES+1];
@@ -457,7 +561,7 @@ ALN read_msf(FILE *fin,int nseqs)
 
 	for(seqno=0;seqno<nseqs;seqno++) {
 
-        	fseek(fin,0,0);                 /* start at the beginning */
+        	fseek(fin,start,0);             /* start at the beginning */
 
         	len=0;                         /* initialise length to zero */
         	for(i=0;;i++) {
@@ -466,6 +570,7 @@ ALN read_msf(FILE *fin,int nseqs)
         	}
 
         	while (fgets(line,MAXLINE+1,fin) != NULL) {
+			if(test_aln_end(line)) break;	/* next record */
                 	if(!blankline(line)) {
 
                         	for(i=0;i<seqno;i++) fgets(line,MAXLINE+1,fin);
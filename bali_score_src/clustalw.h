@@ -716,6 +716,13 @@ int jnet(ALNPTR mult_aln, sint *aligned_group, sint i, char *ss);
 /* readxml.c */
 sint count_xml_seqs(FILE *fin);
 ALN read_xml(FILE *fin,int first_seq);
+void free_xml_parser(void);
+
+/* readmanifest.c */
+int next_manifest_pair(FILE *fin,char *label,char *refname,ALNPTR ref_aln);
+int index_test_alns(FILE *fin,char *testfile);
+long find_test_aln(char *label,Boolean *pruned);
+Boolean test_aln_end(char *line);
 
 /* rascal_util.c */
 
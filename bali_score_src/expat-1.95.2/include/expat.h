@@ -165,6 +165,18 @@ XML_ParserCreate_MM(const XML_Char *encoding,
 		    const XML_Memory_Handling_Suite *memsuite,
 		    const XML_Char *namespaceSeparator);
 
+/* Prepares a parser object to be re-used.  This is particularly
+valuable when memory allocation overhead is disproportionately high,
+such as when a large number of small documents need to be parsed.
+All handlers are cleared from the parser, and the memory it holds
+(buffers, tag stack, string pools and hash table vectors) is kept for
+the next document.  The parser must not have been created by
+XML_ExternalEntityParserCreate.  Returns 0 if the parser could not be
+reset, in which case it should be freed with XML_ParserFree. */
+
+XMLPARSEAPI(int)
+XML_ParserReset(XML_Parser parser, const XML_Char *encoding);
+
 /* atts is array of name/value pairs, terminated by 0;
    names and values are 0 terminated. */
 
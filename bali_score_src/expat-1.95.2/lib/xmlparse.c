@@ -72,17 +72,33 @@ typedef struct {
   KEY name;
 } NAMED;
 
+/* Hash tables use open addressing over buckets of HASH_BUCKET_SLOTS
+entries, so that a bucket fills a 64 byte cache line on LP64 systems.
+Each slot keeps the full hash of its key next to the entry, so probing
+only dereferences entries whose hash matches, and growing the table
+never recomputes a hash.  Entries are only ever removed all at once,
+so a probe can stop at the first empty slot. */
+
+#define HASH_BUCKET_SLOTS 4
+
+typedef struct {
+  unsigned long hash[HASH_BUCKET_SLOTS];
+  NAMED *named[HASH_BUCKET_SLOTS];
+} HASH_BUCKET;
+
 typedef struct {
-  NAMED **v;
-  size_t size;
+  HASH_BUCKET *v;
+  size_t size;		/* number of buckets, a power of 2 */
   size_t used;
   size_t usedLim;
+  size_t hint;		/* entries to allow for when first allocated */
   XML_Memory_Handling_Suite *mem;
 } HASH_TABLE;
 
 typedef struct {
-  NAMED **p;
-  NAMED **end;
+  const HASH_BUCKET *p;
+  const HASH_BUCKET *end;
+  int slot;
 } HASH_TABLE_ITER;
 
 #define INIT_TAG_BUF_SIZE 32  /* must be a multiple of sizeof(XML_Char) */
@@ -286,6 +302,8 @@ static int setContext(XML_Parser parser, const XML_Char *context);
 static void normalizePublicId(XML_Char *s);
 static int dtdInit(DTD *, XML_Parser parser);
 
+static void dtdReset(DTD *, XML_Parser parser);
+
 static void dtdDestroy(DTD *, XML_Parser parser);
 
 static int dtdCopy(DTD *newDtd, const DTD *oldDtd, XML_Parser parser);
@@ -300,7 +318,9 @@ static void dtdSwap(DTD *, DTD *);
 static NAMED *lookup(HASH_TABLE *table, KEY name, size_t createSize);
 
 static void hashTableInit(HASH_TABLE *, XML_Memory_Handling_Suite *ms);
+static int hashTableReserve(HASH_TABLE *, size_t n);
 
+static void hashTableClear(HASH_TABLE *);
 static void hashTableDestroy(HASH_TABLE *);
 static void hashTableIterInit(HASH_TABLE_ITER *, const HASH_TABLE *);
 static NAMED *hashTableIterNext(HASH_TABLE_ITER *);
@@ -545,48 +565,34 @@ XML_Parser XML_ParserCreateNS(const XML_Char *encodingName, XML_Char nsSep)
   return XML_ParserCreate_MM(encodingName, NULL, tmp);
 }
 
-XML_Parser
-XML_ParserCreate_MM(const XML_Char *encodingName,
-		    const XML_Memory_Handling_Suite *memsuite,
-		    const XML_Char *nameSep) {
-  
-  XML_Parser parser;
-  static
-  const XML_Char implicitContext[] = {
-    XML_T('x'), XML_T('m'), XML_T('l'), XML_T('='),
-    XML_T('h'), XML_T('t'), XML_T('t'), XML_T('p'), XML_T(':'),
-    XML_T('/'), XML_T('/'), XML_T('w'), XML_T('w'), XML_T('w'),
-    XML_T('.'), XML_T('w'), XML_T('3'),
-    XML_T('.'), XML_T('o'), XML_T('r'), XML_T('g'),
-    XML_T('/'), XML_T('X'), XML_T('M'), XML_T('L'),
-    XML_T('/'), XML_T('1'), XML_T('9'), XML_T('9'), XML_T('8'),
-    XML_T('/'), XML_T('n'), XML_T('a'), XML_T('m'), XML_T('e'),
-    XML_T('s'), XML_T('p'), XML_T('a'), XML_T('c'), XML_T('e'),
-    XML_T('\0')
-  };
-
-
-  if (memsuite) {
-    XML_Memory_Handling_Suite *mtemp;
-    parser = memsuite->malloc_fcn(sizeof(Parser));
-    mtemp = &(((Parser *) parser)->m_mem);
-    mtemp->malloc_fcn = memsuite->malloc_fcn;
-    mtemp->realloc_fcn = memsuite->realloc_fcn;
-    mtemp->free_fcn = memsuite->free_fcn;
-  }
-  else {
-    XML_Memory_Handling_Suite *mtemp;
-    parser = malloc(sizeof(Parser));
-    mtemp = &(((Parser *) parser)->m_mem);
-    mtemp->malloc_fcn = malloc;
-    mtemp->realloc_fcn = realloc;
-    mtemp->free_fcn = free;
-  }
+static const XML_Char implicitContext[] = {
+  XML_T('x'), XML_T('m'), XML_T('l'), XML_T('='),
+  XML_T('h'), XML_T('t'), XML_T('t'), XML_T('p'), XML_T(':'),
+  XML_T('/'), XML_T('/'), XML_T('w'), XML_T('w'), XML_T('w'),
+  XML_T('.'), XML_T('w'), XML_T('3'),
+  XML_T('.'), XML_T('o'), XML_T('r'), XML_T('g'),
+  XML_T('/'), XML_T('X'), XML_T('M'), XML_T('L'),
+  XML_T('/'), XML_T('1'), XML_T('9'), XML_T('9'), XML_T('8'),
+  XML_T('/'), XML_T('n'), XML_T('a'), XML_T('m'), XML_T('e'),
+  XML_T('s'), XML_T('p'), XML_T('a'), XML_T('c'), XML_T('e'),
+  XML_T('\0')
+};
+
+/* Sets up the per-document state: handlers, encoding, position and
+the processor.  Memory that survives a reset (buffers, atts, pools,
+the DTD tables) is set up by the caller. */
 
-  if (!parser)
-    return parser;
+static
+void parserInit(XML_Parser parser, const XML_Char *encodingName)
+{
   processor = prologInitProcessor;
   XmlPrologStateInit(&prologState);
+  protocolEncodingName = encodingName ? poolCopyString(&tempPool, encodingName) : 0;
+  curBase = 0;
+  if (ns)
+    XmlInitEncodingNS(&initEncoding, &encoding, 0);
+  else
+    XmlInitEncoding(&initEncoding, &encoding, 0);
   userData = 0;
   handlerArg = 0;
   startElementHandler = 0;
@@ -611,12 +617,10 @@ XML_ParserCreate_MM(const XML_Char *encodingName,
   attlistDeclHandler = 0;
   entityDeclHandler = 0;
   xmlDeclHandler = 0;
-  buffer = 0;
-  bufferPtr = 0;
-  bufferEnd = 0;
+  bufferPtr = buffer;
+  bufferEnd = buffer;
   parseEndByteIndex = 0;
   parseEndPtr = 0;
-  bufferLim = 0;
   declElementType = 0;
   declAttributeId = 0;
   declEntity = 0;
@@ -632,33 +636,70 @@ XML_ParserCreate_MM(const XML_Char *encodingName,
   eventEndPtr = 0;
   positionPtr = 0;
   openInternalEntities = 0;
+  defaultExpandInternalEntities = 1;
   tagLevel = 0;
   tagStack = 0;
-  freeTagList = 0;
-  freeBindingList = 0;
   inheritedBindings = 0;
-  attsSize = INIT_ATTS_SIZE;
-  atts = MALLOC(attsSize * sizeof(ATTRIBUTE));
   nSpecifiedAtts = 0;
-  dataBuf = MALLOC(INIT_DATA_BUF_SIZE * sizeof(XML_Char));
-  groupSize = 0;
-  groupConnector = 0;
   hadExternalDoctype = 0;
   unknownEncodingMem = 0;
   unknownEncodingRelease = 0;
   unknownEncodingData = 0;
   unknownEncodingHandlerData = 0;
-  namespaceSeparator = '!';
 #ifdef XML_DTD
   parentParser = 0;
   paramEntityParsing = XML_PARAM_ENTITY_PARSING_NEVER;
 #endif
+}
+
+XML_Parser
+XML_ParserCreate_MM(const XML_Char *encodingName,
+		    const XML_Memory_Handling_Suite *memsuite,
+		    const XML_Char *nameSep) {
+  
+  XML_Parser parser;
+
+  if (memsuite) {
+    XML_Memory_Handling_Suite *mtemp;
+    parser = memsuite->malloc_fcn(sizeof(Parser));
+    if (!parser)
+      return parser;
+    mtemp = &(((Parser *) parser)->m_mem);
+    mtemp->malloc_fcn = memsuite->malloc_fcn;
+    mtemp->realloc_fcn = memsuite->realloc_fcn;
+    mtemp->free_fcn = memsuite->free_fcn;
+  }
+  else {
+    XML_Memory_Handling_Suite *mtemp;
+    parser = malloc(sizeof(Parser));
+    if (!parser)
+      return parser;
+    mtemp = &(((Parser *) parser)->m_mem);
+    mtemp->malloc_fcn = malloc;
+    mtemp->realloc_fcn = realloc;
+    mtemp->free_fcn = free;
+  }
+
+  buffer = 0;
+  bufferLim = 0;
+  freeTagList = 0;
+  freeBindingList = 0;
+  attsSize = INIT_ATTS_SIZE;
+  atts = MALLOC(attsSize * sizeof(ATTRIBUTE));
+  dataBuf = MALLOC(INIT_DATA_BUF_SIZE * sizeof(XML_Char));
+  groupSize = 0;
+  groupConnector = 0;
+  namespaceSeparator = '!';
   ns = 0;
   ns_triplets = 0;
+  if (nameSep) {
+    ns = 1;
+    namespaceSeparator = *nameSep;
+  }
+  internalEncoding = ns ? XmlGetInternalEncodingNS() : XmlGetInternalEncoding();
   poolInit(&tempPool, &(((Parser *) parser)->m_mem));
   poolInit(&temp2Pool, &(((Parser *) parser)->m_mem));
-  protocolEncodingName = encodingName ? poolCopyString(&tempPool, encodingName) : 0;
-  curBase = 0;
+  parserInit(parser, encodingName);
   if (!dtdInit(&dtd, parser) || !atts || !dataBuf
       || (encodingName && !protocolEncodingName)) {
     XML_ParserFree(parser);
@@ -666,25 +707,59 @@ XML_ParserCreate_MM(const XML_Char *encodingName,
   }
   dataBufEnd = dataBuf + INIT_DATA_BUF_SIZE;
 
-  if (nameSep) {
-    XmlInitEncodingNS(&initEncoding, &encoding, 0);
-    ns = 1;
-    internalEncoding = XmlGetInternalEncodingNS();
-    namespaceSeparator = *nameSep;
-
-    if (! setContext(parser, implicitContext)) {
-      XML_ParserFree(parser);
-      return 0;
-    }
-  }
-  else {
-    XmlInitEncoding(&initEncoding, &encoding, 0);
-    internalEncoding = XmlGetInternalEncoding();
+  if (ns && !setContext(parser, implicitContext)) {
+    XML_ParserFree(parser);
+    return 0;
   }
 
   return parser;
 }  /* End XML_ParserCreate_MM */
 
+static
+void moveToFreeBindingList(XML_Parser parser, BINDING *bindings)
+{
+  while (bindings) {
+    BINDING *b = bindings;
+    bindings = bindings->nextTagBinding;
+    b->nextTagBinding = freeBindingList;
+    freeBindingList = b;
+  }
+}
+
+int XML_ParserReset(XML_Parser parser, const XML_Char *encodingName)
+{
+  TAG *tStk;
+#ifdef XML_DTD
+  if (parentParser)
+    return 0;
+#endif
+  /* Keep the tag buffers and bindings of an unfinished document for
+     reuse, as the tag stack does when elements close. */
+  tStk = tagStack;
+  while (tStk) {
+    TAG *tag = tStk;
+    tStk = tStk->parent;
+    tag->parent = freeTagList;
+    moveToFreeBindingList(parser, tag->bindings);
+    tag->bindings = 0;
+    freeTagList = tag;
+  }
+  moveToFreeBindingList(parser, inheritedBindings);
+  if (unknownEncodingMem)
+    FREE(unknownEncodingMem);
+  if (unknownEncodingRelease)
+    unknownEncodingRelease(unknownEncodingData);
+  poolClear(&tempPool);
+  poolClear(&temp2Pool);
+  dtdReset(&dtd, parser);
+  parserInit(parser, encodingName);
+  if (encodingName && !protocolEncodingName)
+    return 0;
+  if (ns && !setContext(parser, implicitContext))
+    return 0;
+  return 1;
+}
+
 int XML_SetEncoding(XML_Parser parser, const XML_Char *encodingName)
 {
   if (!encodingName)
@@ -4010,6 +4085,46 @@ static void dtdSwap(DTD *p1, DTD *p2)
 
 #endif /* XML_DTD */
 
+/* Empties the DTD for the next document, keeping the hash table
+vectors and the string pool blocks. */
+
+static void dtdReset(DTD *p, XML_Parser parser)
+{
+  HASH_TABLE_ITER iter;
+  hashTableIterInit(&iter, &(p->elementTypes));
+  for (;;) {
+    ELEMENT_TYPE *e = (ELEMENT_TYPE *)hashTableIterNext(&iter);
+    if (!e)
+      break;
+    if (e->allocDefaultAtts != 0)
+      FREE(e->defaultAtts);
+  }
+  hashTableClear(&(p->generalEntities));
+#ifdef XML_DTD
+  hashTableClear(&(p->paramEntities));
+#endif /* XML_DTD */
+  hashTableClear(&(p->elementTypes));
+  hashTableClear(&(p->attributeIds));
+  hashTableClear(&(p->prefixes));
+  poolClear(&(p->pool));
+  p->complete = 1;
+  p->standalone = 0;
+  p->defaultPrefix.name = 0;
+  p->defaultPrefix.binding = 0;
+
+  p->in_eldecl = 0;
+  if (p->scaffIndex)
+    FREE(p->scaffIndex);
+  p->scaffIndex = 0;
+  if (p->scaffold)
+    FREE(p->scaffold);
+  p->scaffold = 0;
+  p->scaffLevel = 0;
+  p->contentStringLen = 0;
+  p->scaffSize = 0;
+  p->scaffCount = 0;
+}
+
 static void dtdDestroy(DTD *p, XML_Parser parser)
 {
   HASH_TABLE_ITER iter;
@@ -4042,6 +4157,11 @@ static int dtdCopy(DTD *newDtd, const DTD *oldDtd, XML_Parser parser)
 {
   HASH_TABLE_ITER iter;
 
+  if (!hashTableReserve(&(newDtd->prefixes), oldDtd->prefixes.used)
+      || !hashTableReserve(&(newDtd->attributeIds), oldDtd->attributeIds.used)
+      || !hashTableReserve(&(newDtd->elementTypes), oldDtd->elementTypes.used))
+    return 0;
+
   /* Copy the prefix table. */
 
   hashTableIterInit(&iter, &(oldDtd->prefixes));
@@ -4164,6 +4284,9 @@ static int copyEntityTable(HASH_TABLE *newTable,
   const XML_Char *cachedOldBase = 0;
   const XML_Char *cachedNewBase = 0;
 
+  if (!hashTableReserve(newTable, oldTable->used))
+    return 0;
+
   hashTableIterInit(&iter, oldTable);
 
   for (;;) {
@@ -4212,7 +4335,7 @@ static int copyEntityTable(HASH_TABLE *newTable,
   return 1;
 }
 
-#define INIT_SIZE 64
+#define INIT_SIZE 16	/* buckets */
 
 static
 int keyeq(KEY s1, KEY s2)
@@ -4229,71 +4352,145 @@ unsigned long hash(KEY s)
   unsigned long h = 0;
   while (*s)
     h = (h << 5) + h + (unsigned char)*s++;
+  /* spread similar names such as e1, e2, ... over the low bits used
+     to pick a bucket */
+  h ^= h >> 15;
+  h *= 0x2C1B3C6DUL;
+  h ^= h >> 12;
   return h;
 }
 
+/* Tables grow when three quarters of the slots are in use. */
+#define HASH_USED_LIM(size) ((size) * HASH_BUCKET_SLOTS / 4 * 3)
+
 static
-NAMED *lookup(HASH_TABLE *table, KEY name, size_t createSize)
+size_t hashTableBuckets(size_t n)
 {
+  size_t size = INIT_SIZE;
+  while (HASH_USED_LIM(size) < n)
+    size *= 2;
+  return size;
+}
+
+/* Returns the bucket holding name, or the bucket with the first free
+slot on name's probe sequence; *slot is set to the slot in either
+case. */
+
+static
+HASH_BUCKET *hashTableProbe(const HASH_TABLE *table, KEY name,
+			    unsigned long h, int *slot)
+{
+  size_t mask = table->size - 1;
   size_t i;
-  if (table->size == 0) {
-    size_t tsize;
+  for (i = h & mask;; i = (i + 1) & mask) {
+    HASH_BUCKET *b = table->v + i;
+    int k;
+    for (k = 0; k < HASH_BUCKET_SLOTS; k++) {
+      if (!b->named[k]
+	  || (b->hash[k] == h && keyeq(name, b->named[k]->name))) {
+	*slot = k;
+	return b;
+      }
+    }
+  }
+}
+
+/* Moves all entries into a vector of newSize buckets. */
 
+static
+int hashTableResize(HASH_TABLE *table, size_t newSize)
+{
+  size_t tsize = newSize * sizeof(HASH_BUCKET);
+  size_t mask = newSize - 1;
+  size_t i;
+  HASH_BUCKET *newV = table->mem->malloc_fcn(tsize);
+  if (!newV)
+    return 0;
+  memset(newV, 0, tsize);
+  for (i = 0; i < table->size; i++) {
+    int k;
+    for (k = 0; k < HASH_BUCKET_SLOTS && table->v[i].named[k]; k++) {
+      unsigned long h = table->v[i].hash[k];
+      size_t j;
+      int m = HASH_BUCKET_SLOTS;
+      for (j = h & mask;; j = (j + 1) & mask) {
+	for (m = 0; m < HASH_BUCKET_SLOTS && newV[j].named[m]; m++)
+	  ;
+	if (m < HASH_BUCKET_SLOTS)
+	  break;
+      }
+      newV[j].hash[m] = h;
+      newV[j].named[m] = table->v[i].named[k];
+    }
+  }
+  if (table->v)
+    table->mem->free_fcn(table->v);
+  table->v = newV;
+  table->size = newSize;
+  table->usedLim = HASH_USED_LIM(newSize);
+  return 1;
+}
+
+static
+NAMED *lookup(HASH_TABLE *table, KEY name, size_t createSize)
+{
+  unsigned long h = hash(name);
+  HASH_BUCKET *b;
+  int k;
+  if (table->size == 0) {
     if (!createSize)
       return 0;
-    tsize = INIT_SIZE * sizeof(NAMED *);
-    table->v = table->mem->malloc_fcn(tsize);
-    if (!table->v)
+    if (!hashTableResize(table, hashTableBuckets(table->hint)))
       return 0;
-    memset(table->v, 0, tsize);
-    table->size = INIT_SIZE;
-    table->usedLim = INIT_SIZE / 2;
-    i = hash(name) & (table->size - 1);
   }
   else {
-    unsigned long h = hash(name);
-    for (i = h & (table->size - 1);
-         table->v[i];
-         i == 0 ? i = table->size - 1 : --i) {
-      if (keyeq(name, table->v[i]->name))
-	return table->v[i];
-    }
+    b = hashTableProbe(table, name, h, &k);
+    if (b->named[k])
+      return b->named[k];
     if (!createSize)
       return 0;
-    if (table->used == table->usedLim) {
-      /* check for overflow */
-      size_t newSize = table->size * 2;
-      size_t tsize = newSize * sizeof(NAMED *);
-      NAMED **newV = table->mem->malloc_fcn(tsize);
-      if (!newV)
-	return 0;
-      memset(newV, 0, tsize);
-      for (i = 0; i < table->size; i++)
-	if (table->v[i]) {
-	  size_t j;
-	  for (j = hash(table->v[i]->name) & (newSize - 1);
-	       newV[j];
-	       j == 0 ? j = newSize - 1 : --j)
-	    ;
-	  newV[j] = table->v[i];
-	}
-      table->mem->free_fcn(table->v);
-      table->v = newV;
-      table->size = newSize;
-      table->usedLim = newSize/2;
-      for (i = h & (table->size - 1);
-	   table->v[i];
-	   i == 0 ? i = table->size - 1 : --i)
-	;
-    }
+    if (table->used == table->usedLim
+	&& !hashTableResize(table, table->size * 2))
+      return 0;
   }
-  table->v[i] = table->mem->malloc_fcn(createSize);
-  if (!table->v[i])
+  b = hashTableProbe(table, name, h, &k);
+  b->named[k] = table->mem->malloc_fcn(createSize);
+  if (!b->named[k])
     return 0;
-  memset(table->v[i], 0, createSize);
-  table->v[i]->name = name;
+  memset(b->named[k], 0, createSize);
+  b->named[k]->name = name;
+  b->hash[k] = h;
   (table->used)++;
-  return table->v[i];
+  return b->named[k];
+}
+
+/* Makes room for n entries without further growth.  Before the first
+insertion this only records the hint. */
+
+static
+int hashTableReserve(HASH_TABLE *table, size_t n)
+{
+  if (table->size == 0) {
+    table->hint = n;
+    return 1;
+  }
+  if (n <= table->usedLim)
+    return 1;
+  return hashTableResize(table, hashTableBuckets(n));
+}
+
+static
+void hashTableClear(HASH_TABLE *table)
+{
+  size_t i;
+  for (i = 0; i < table->size; i++) {
+    int k;
+    for (k = 0; k < HASH_BUCKET_SLOTS && table->v[i].named[k]; k++)
+      table->mem->free_fcn(table->v[i].named[k]);
+  }
+  if (table->v)
+    memset(table->v, 0, table->size * sizeof(HASH_BUCKET));
+  table->used = 0;
 }
 
 static
@@ -4301,9 +4498,9 @@ void hashTableDestroy(HASH_TABLE *table)
 {
   size_t i;
   for (i = 0; i < table->size; i++) {
-    NAMED *p = table->v[i];
-    if (p)
-      table->mem->free_fcn(p);
+    int k;
+    for (k = 0; k < HASH_BUCKET_SLOTS && table->v[i].named[k]; k++)
+      table->mem->free_fcn(table->v[i].named[k]);
   }
   if (table->v)
     table->mem->free_fcn(table->v);
@@ -4315,6 +4512,7 @@ void hashTableInit(HASH_TABLE *p, XML_Memory_Handling_Suite *ms)
   p->size = 0;
   p->usedLim = 0;
   p->used = 0;
+  p->hint = 0;
   p->v = 0;
   p->mem = ms;
 }
@@ -4324,13 +4522,18 @@ void hashTableIterInit(HASH_TABLE_ITER *iter, const HASH_TABLE *table)
 {
   iter->p = table->v;
   iter->end = iter->p + table->size;
+  iter->slot = 0;
 }
 
 static
 NAMED *hashTableIterNext(HASH_TABLE_ITER *iter)
 {
   while (iter->p != iter->end) {
-    NAMED *tem = *(iter->p)++;
+    NAMED *tem = iter->p->named[iter->slot];
+    if (++iter->slot == HASH_BUCKET_SLOTS) {
+      iter->slot = 0;
+      iter->p++;
+    }
     if (tem)
       return tem;
   }
@@ -7,6 +7,12 @@ See the file COPYING for copying permission.
 #define IS_INVALID_CHAR(enc, ptr, n) (0)
 #endif
 
+/* Returns the first byte in [ptr, end) that might not be plain
+character data; encodings without a fast scanner return ptr. */
+#ifndef SKIP_DATA_CHARS
+#define SKIP_DATA_CHARS(enc, ptr, end) (ptr)
+#endif
+
 #define INVALID_LEAD_CASE(n, ptr, nextTokPtr) \
     case BT_LEAD ## n: \
       if (end - ptr < n) \
@@ -828,6 +834,7 @@ int PREFIX(contentTok)(const ENCODING *enc, const char *ptr, const char *end,
     ptr += MINBPC(enc);
     break;
   }
+  ptr = SKIP_DATA_CHARS(enc, ptr, end);
   while (ptr != end) {
     switch (BYTE_TYPE(enc, ptr)) {
 #define LEAD_CASE(n) \
@@ -837,6 +844,7 @@ int PREFIX(contentTok)(const ENCODING *enc, const char *ptr, const char *end,
 	return XML_TOK_DATA_CHARS; \
       } \
       ptr += n; \
+      ptr = SKIP_DATA_CHARS(enc, ptr, end); \
       break;
     LEAD_CASE(2) LEAD_CASE(3) LEAD_CASE(4)
 #undef LEAD_CASE
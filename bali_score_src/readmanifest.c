@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include "clustalw.h"
+
+/* Reads the pair manifests written by splitPairs (see pairManifest.h in the
+aligner sources). Each P record gives the reference alignment of one pair as
+run-length M/D/I operations over the two sequences, whose residues are read
+from the family's .tfa file at the byte ranges given by the S records. The
+test alignments for all pairs are MSF records concatenated in one file, each
+preceded by a "Pair: <label>" line. An archive written by cpuSmithWaterman -o
+also has an index, <archive>.idx, with one "offset length family label" line
+per record. A pair that a run with --min-score pruned has a Pair: line with
+no MSF after it, and length 0 in the index. */
+
+#define PAIR_TAG "Pair: "
+
+typedef struct {
+	char name[MAXNAMES+1];
+	long offset;
+	long bytes;
+	int length;
+} MSEQ;
+
+char Family[MAXNAMES+1];	/* current family */
+char Msfname[FILENAMELEN+1];	/* its reference alignment, for messages */
+FILE *Tfa=NULL;			/* its sequence file */
+MSEQ *Mseqs=NULL;		/* its sequences */
+int Nmseqs=0;
+int Maxmseqs=0;
+
+char **Labels=NULL;		/* labels of the test alignments */
+long *Offsets=NULL;		/* and where each one starts */
+Boolean *Pruned=NULL;		/* and whether it was pruned, with no MSF */
+int Nlabels=0;
+int Lastlabel=0;
+
+static int find_mseq(char *name)
+{
+	int i;
+
+	for(i=0;i<Nmseqs;i++)
+		if(strcmp(Mseqs[i].name,name)==0) return i;
+	return -1;
+}
+
+static char *read_residues(MSEQ *s)
+{
+	char *raw,*seq;
+	int i,n;
+
+	raw=(char *)ckalloc((s->bytes+1)*sizeof(char));
+	seq=(char *)ckalloc((s->length+2)*sizeof(char));
+	fseek(Tfa,s->offset,0);
+	if(fread(raw,1,s->bytes,Tfa)!=(size_t)s->bytes) {
+		ckfree(raw);
+		return ckfree(seq);
+	}
+	for(i=n=0;i<s->bytes && n<=s->length;i++)
+		if(!isspace((unsigned char)raw[i])) seq[n++]=raw[i];
+	seq[n]=EOS;
+	ckfree(raw);
+	if(n!=s->length) return ckfree(seq);
+	return seq;
+}
+
+/* build the two-sequence reference alignment from the residues and the
+run-length operations */
+static int build_ref(ALNPTR ref_aln,MSEQ *s1,MSEQ *s2,char *ops)
+{
+	char *r1,*r2,*p;
+	int i,n,ncols,i1,i2;
+
+	ncols=0;
+	for(p=ops;*p;) {
+		n=strtol(p,&p,10);
+		if(n<=0 || (*p!='M' && *p!='D' && *p!='I')) return 0;
+		ncols+=n;
+		p++;
+	}
+	r1=read_residues(s1);
+	r2=read_residues(s2);
+	if(r1==NULL || r2==NULL) {
+		if(r1!=NULL) ckfree(r1);
+		if(r2!=NULL) ckfree(r2);
+		return 0;
+	}
+
+	alloc_aln(2,ref_aln);
+	ref_aln->nseqs=2;
+	strcpy(ref_aln->seqs[0].name,s1->name);
+	strcpy(ref_aln->seqs[1].name,s2->name);
+	alloc_seq(&ref_aln->seqs[0],ncols);
+	alloc_seq(&ref_aln->seqs[1],ncols);
+	i1=i2=ncols=0;
+	for(p=ops;*p;p++) {
+		n=strtol(p,&p,10);
+		for(i=0;i<n;i++,ncols++) {
+			if(*p!='I' && i1>=s1->length) break;
+			if(*p!='D' && i2>=s2->length) break;
+			ref_aln->seqs[0].data[ncols]=(*p=='I') ? '-' : r1[i1++];
+			ref_aln->seqs[1].data[ncols]=(*p=='D') ? '-' : r2[i2++];
+		}
+	}
+	ref_aln->seqs[0].data[ncols]=ref_aln->seqs[1].data[ncols]=EOS;
+	ref_aln->seqs[0].len=ref_aln->seqs[1].len=ncols;
+	ckfree(r1);
+	ckfree(r2);
+	if(i1!=s1->length || i2!=s2->length) {
+		free_aln(ref_aln);
+		return 0;
+	}
+	return 1;
+}
+
+/* Read manifest records up to the next pair with a reference, and build its
+reference alignment. Returns 1 for a pair, 0 at the end of the manifest and -1
+on error. label is set to <family>_<name1>__<name2>, refname to the family's
+reference alignment file. */
+int next_manifest_pair(FILE *fin,char *label,char *refname,ALNPTR ref_aln)
+{
+	static char line[MAXLINE+1];
+	char tag[MAXLINE+1],a[MAXLINE+1],b[MAXLINE+1],c[MAXLINE+1];
+	long offset,bytes;
+	int length,s1,s2;
+
+	while(fgets(line,MAXLINE+1,fin)!=NULL) {
+		if(line[0]=='#' || blankline(line)) continue;
+		if(sscanf(line,"%s",tag)!=1) continue;
+		if(strcmp(tag,"F")==0) {
+			if(sscanf(line,"%*s %s %s %s",a,b,c)!=3 || strlen(a)>MAXNAMES || strlen(c)>FILENAMELEN) {
+				fprintf(stderr,"Error: bad manifest record: %s",line);
+				return -1;
+			}
+			if(Tfa!=NULL) fclose(Tfa);
+			if((Tfa=fopen(b,"rb"))==NULL) {
+				fprintf(stderr,"Cannot open sequence file [%s]\n",b);
+				return -1;
+			}
+			strcpy(Family,a);
+			strcpy(Msfname,c);
+			Nmseqs=0;
+		}
+		else if(strcmp(tag,"S")==0 && Tfa!=NULL) {
+			if(sscanf(line,"%*s %s %ld %ld %d",a,&offset,&bytes,&length)!=4 || strlen(a)>MAXNAMES) {
+				fprintf(stderr,"Error: bad manifest record: %s",line);
+				return -1;
+			}
+			if(Mseqs==NULL) {
+				Maxmseqs=100;
+				Mseqs=(MSEQ *)ckalloc(Maxmseqs*sizeof(MSEQ));
+			}
+			else if(Nmseqs==Maxmseqs) {
+				Maxmseqs+=100;
+				Mseqs=(MSEQ *)ckrealloc(Mseqs,Maxmseqs*sizeof(MSEQ));
+			}
+			strcpy(Mseqs[Nmseqs].name,a);
+			Mseqs[Nmseqs].offset=offset;
+			Mseqs[Nmseqs].bytes=bytes;
+			Mseqs[Nmseqs].length=length;
+			Nmseqs++;
+		}
+		else if(strcmp(tag,"P")==0 && Tfa!=NULL) {
+			if(sscanf(line,"%*s %s %s %s",a,b,c)!=3 ||
+			   (s1=find_mseq(a))<0 || (s2=find_mseq(b))<0) {
+				fprintf(stderr,"Error: bad manifest record: %s",line);
+				return -1;
+			}
+			sprintf(label,"%s_%s__%s",Family,a,b);
+			if(strcmp(c,"-")==0) {
+				fprintf(stderr,"Warning: no reference alignment for %s\n",label);
+				continue;
+			}
+			if(!build_ref(ref_aln,&Mseqs[s1],&Mseqs[s2],c)) {
+				fprintf(stderr,"Error: reference for %s does not match the sequences\n",label);
+				return -1;
+			}
+			strcpy(refname,Msfname);
+			return 1;
+		}
+		else {
+			fprintf(stderr,"Error: bad manifest record: %s",line);
+			return -1;
+		}
+	}
+	if(Tfa!=NULL) fclose(Tfa);
+	Tfa=NULL;
+	return 0;
+}
+
+static void add_label(char *label,size_t len,long offset,Boolean pruned)
+{
+	static int maxlabels=0;
+
+	if(Labels==NULL) {
+		maxlabels=1000;
+		Labels=(char **)ckalloc(maxlabels*sizeof(char *));
+		Offsets=(long *)ckalloc(maxlabels*sizeof(long));
+		Pruned=(Boolean *)ckalloc(maxlabels*sizeof(Boolean));
+	}
+	else if(Nlabels==maxlabels) {
+		maxlabels+=1000;
+		Labels=(char **)ckrealloc(Labels,maxlabels*sizeof(char *));
+		Offsets=(long *)ckrealloc(Offsets,maxlabels*sizeof(long));
+		Pruned=(Boolean *)ckrealloc(Pruned,maxlabels*sizeof(Boolean));
+	}
+	Labels[Nlabels]=(char *)ckalloc((len+1)*sizeof(char));
+	strncpy(Labels[Nlabels],label,len);
+	Labels[Nlabels][len]=EOS;
+	Offsets[Nlabels]=offset;
+	Pruned[Nlabels]=pruned;
+	Nlabels++;
+}
+
+/* Note where each test alignment starts in a file of concatenated records,
+from its index if there is one. Returns the number of records. */
+int index_test_alns(FILE *fin,char *testfile)
+{
+	static char line[MAXLINE+1];
+	char label[MAXLINE+1];
+	char idxname[FILENAMELEN+5];
+	long offset,length;
+	FILE *ifd=NULL;
+
+	Nlabels=Lastlabel=0;
+	if(strlen(testfile)<=FILENAMELEN) {
+		sprintf(idxname,"%s.idx",testfile);
+		ifd=fopen(idxname,"r");
+	}
+	if(ifd!=NULL) {
+		while(fgets(line,MAXLINE+1,ifd)!=NULL)
+			if(sscanf(line,"%ld %ld %*s %s",&offset,&length,label)==3)
+				add_label(label,strlen(label),offset,length==0);
+		fclose(ifd);
+		return Nlabels;
+	}
+
+	fseek(fin,0,0);
+	while(fgets(line,MAXLINE+1,fin)!=NULL) {
+		if(strncmp(line,PAIR_TAG,strlen(PAIR_TAG))!=0) {
+			/* a record with any MSF text was not pruned */
+			if(Nlabels>0) Pruned[Nlabels-1]=FALSE;
+			continue;
+		}
+		add_label(line+strlen(PAIR_TAG),strcspn(line+strlen(PAIR_TAG),"\r\n"),ftell(fin),TRUE);
+	}
+	return Nlabels;
+}
+
+/* Find the start of the test alignment for label, or -1, and whether the
+pair was pruned. The aligner writes records in manifest order, so the search
+starts after the last one found. */
+long find_test_aln(char *label,Boolean *pruned)
+{
+	int i,n;
+
+	for(n=0;n<Nlabels;n++) {
+		i=(Lastlabel+n)%Nlabels;
+		if(strcmp(Labels[i],label)==0) {
+			Lastlabel=i+1;
+			*pruned=Pruned[i];
+			return Offsets[i];
+		}
+	}
+	return -1;
+}
+
+/* Is line the start of the next record in a file of test alignments? */
+Boolean test_aln_end(char *line)
+{
+	return strncmp(line,PAIR_TAG,strlen(PAIR_TAG))==0;
+}
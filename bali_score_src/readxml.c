@@ -28,6 +28,137 @@ ALN Maln;
 
 static void do_element(void);
 
+/* The same parser is reset and re-used for every pass over an xml file, and
+all of its memory comes from an arena: blocks are cut from large chunks with a
+bump pointer and recycled through free lists, one per power-of-two size class,
+so the allocator is only called when the arena grows. The whole arena is
+returned in one go by free_xml_parser(). */
+
+#define ARENA_CHUNK	65536	/* minimum size of a chunk requested from malloc */
+#define ARENA_MINBLOCK	16	/* size of the smallest size class */
+#define ARENA_NCLASS	28	/* size classes from 16 bytes to 2 Gb */
+
+typedef struct ArenaChunk {
+	struct ArenaChunk *next;
+	double align;
+} ArenaChunk;
+
+/* each block starts with its size class; free blocks keep the free list link
+in the data area */
+typedef union ArenaHdr {
+	int cls;
+	double align;
+	void *ptr;
+} ArenaHdr;
+
+static ArenaChunk *ArenaChunks=NULL;	/* chunks obtained from malloc */
+static char *ArenaPtr=NULL;		/* next free byte in the current chunk */
+static char *ArenaEnd=NULL;		/* end of the current chunk */
+static void *ArenaFree[ARENA_NCLASS];	/* free blocks in each size class */
+
+static XML_Parser Parser=NULL;
+
+static void *arena_malloc(size_t size)
+{
+	int cls;
+	size_t need,csize;
+	ArenaHdr *h;
+	ArenaChunk *c;
+
+	for(cls=0;cls<ARENA_NCLASS && ((size_t)ARENA_MINBLOCK<<cls)<size;cls++)
+		;
+	if(cls==ARENA_NCLASS) return NULL;
+
+	if(ArenaFree[cls]!=NULL) {
+		h=(ArenaHdr *)ArenaFree[cls]-1;
+		ArenaFree[cls]=*(void **)ArenaFree[cls];
+		return h+1;
+	}
+
+	need=sizeof(ArenaHdr)+((size_t)ARENA_MINBLOCK<<cls);
+	if(ArenaPtr==NULL || (size_t)(ArenaEnd-ArenaPtr)<need) {
+		csize=sizeof(ArenaChunk)+need;
+		if(csize<ARENA_CHUNK) csize=ARENA_CHUNK;
+		c=(ArenaChunk *)malloc(csize);
+		if(c==NULL) return NULL;
+		c->next=ArenaChunks;
+		ArenaChunks=c;
+		ArenaPtr=(char *)(c+1);
+		ArenaEnd=(char *)c+csize;
+	}
+	h=(ArenaHdr *)ArenaPtr;
+	h->cls=cls;
+	ArenaPtr+=need;
+	return h+1;
+}
+
+static void arena_free(void *p)
+{
+	ArenaHdr *h;
+
+	if(p==NULL) return;
+	h=(ArenaHdr *)p-1;
+	*(void **)p=ArenaFree[h->cls];
+	ArenaFree[h->cls]=p;
+}
+
+static void *arena_realloc(void *p,size_t size)
+{
+	size_t old;
+	void *q;
+
+	if(p==NULL) return arena_malloc(size);
+	old=(size_t)ARENA_MINBLOCK<<((ArenaHdr *)p-1)->cls;
+	if(size<=old) return p;
+	q=arena_malloc(size);
+	if(q==NULL) return NULL;
+	memcpy(q,p,old);
+	arena_free(p);
+	return q;
+}
+
+static void arena_release(void)
+{
+	int i;
+	ArenaChunk *c;
+
+	while(ArenaChunks!=NULL) {
+		c=ArenaChunks;
+		ArenaChunks=c->next;
+		free(c);
+	}
+	ArenaPtr=ArenaEnd=NULL;
+	for(i=0;i<ARENA_NCLASS;i++)
+		ArenaFree[i]=NULL;
+}
+
+static XML_Memory_Handling_Suite ArenaSuite = {arena_malloc,arena_realloc,arena_free};
+
+/* returns the shared parser, creating it on first use and resetting it after */
+static XML_Parser get_parser(void)
+{
+	if(Parser==NULL)
+		Parser=XML_ParserCreate_MM(NULL,&ArenaSuite,NULL);
+	else if(!XML_ParserReset(Parser,NULL))
+		free_xml_parser();
+
+	if (Parser==NULL) {
+		fprintf(stderr, "Couldn't allocate memory for parser\n");
+		exit(-1);
+	}
+	return Parser;
+}
+
+/* frees the shared parser and everything in the arena */
+void free_xml_parser(void)
+{
+	if(Parser!=NULL) {
+		XML_ParserFree(Parser);
+		Parser=NULL;
+	}
+	arena_release();
+}
+
 /* This is the application specific stuff. When we get here, the element name is contained in
 Element, any attributes are in NAttributes and Attributes, the data is in Content */
 
@@ -310,12 +441,7 @@ sint count_xml_seqs(FILE *fin)
 {
   XML_Parser p;
 
-  p = XML_ParserCreate(NULL);
-
-  if (! p) {
-    fprintf(stderr, "Couldn't allocate memory for parser\n");
-    exit(-1);
-  }
+  p = get_parser();
 
   XML_SetElementHandler(p, c_start, c_end);
 
@@ -348,12 +474,7 @@ ALN read_xml(FILE *fin,int first_seq)
 {
   XML_Parser p;
 
-  p = XML_ParserCreate(NULL);
-
-  if (! p) {
-    fprintf(stderr, "Couldn't allocate memory for parser\n");
-    exit(-1);
-  }
+  p = get_parser();
   alloc_aln(Nseqs,&Maln);
 
   XML_SetElementHandler(p, start, end);
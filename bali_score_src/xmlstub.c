@@ -14,3 +14,7 @@ ALN read_xml(FILE *fin, int first_seq) {
     fprintf(stderr, "Error: XML reader not supported in GCG‐only build.\n");
     exit(1);
 }
+
+/* Nothing to release without a parser */
+void free_xml_parser(void) {
+}
@@ -0,0 +1,165 @@
+// boundedQueue.h - Bounded lock-free multi-producer multi-consumer queue
+//
+// A fixed ring of cells, each with a sequence number telling producers and
+// consumers whose turn it is; a push or pop claims its position with one
+// compare-and-swap and never takes a lock.  When the queue is full or empty,
+// push and pop yield for a few rounds and then sleep on a condition variable
+// until the other side makes room or adds an item, so an idle stage gives up
+// its core during long alignments; the mutex is only taken by a thread about
+// to sleep and by the push or pop that wakes it.  The queue counts those waits
+// and samples its occupancy on every push, so a pipeline can show which of its
+// stages is holding the others up: a queue that is mostly full has a slow
+// consumer, one that is mostly empty a slow producer.
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <cstddef>
+
+template <typename T>
+class BoundedQueue {
+public:
+    // The capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t minCapacity) : enqueuePos(0), dequeuePos(0),
+        pushes(0), occupancySum(0), fullWaits(0), emptyWaits(0), fullSleepers(0), emptySleepers(0) {
+        size_t capacity = 2;
+        while(capacity < minCapacity) capacity *= 2;
+        mask = capacity - 1;
+        cells = std::vector<Cell>(capacity);
+        for(size_t k = 0; k < capacity; ++k) cells[k].seq.store(k, std::memory_order_relaxed);
+    }
+
+    void push(const T& value) {
+        occupancySum.fetch_add(size(), std::memory_order_relaxed);
+        pushes.fetch_add(1, std::memory_order_relaxed);
+        if(!tryPush(value)) {
+            fullWaits.fetch_add(1, std::memory_order_relaxed);
+            waitFor(fullSleepers, notFull, [&] { return tryPush(value); });
+        }
+        wake(emptySleepers, notEmpty);
+    }
+
+    T pop() {
+        T value;
+        if(!tryPop(value)) {
+            emptyWaits.fetch_add(1, std::memory_order_relaxed);
+            waitFor(emptySleepers, notEmpty, [&] { return tryPop(value); });
+        }
+        wake(fullSleepers, notFull);
+        return value;
+    }
+
+    // Number of items queued; exact only when nothing is pushing or popping
+    size_t size() const {
+        size_t in = enqueuePos.load(std::memory_order_relaxed);
+        size_t out = dequeuePos.load(std::memory_order_relaxed);
+        return in > out ? in - out : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Occupancy seen by the average push, and how often push or pop waited
+    double meanOccupancy() const {
+        long n = pushes.load(std::memory_order_relaxed);
+        return n ? (double)occupancySum.load(std::memory_order_relaxed) / n : 0.0;
+    }
+    long pushCount() const { return pushes.load(std::memory_order_relaxed); }
+    long fullWaitCount() const { return fullWaits.load(std::memory_order_relaxed); }
+    long emptyWaitCount() const { return emptyWaits.load(std::memory_order_relaxed); }
+
+private:
+    // Rounds of yielding before a waiting push or pop goes to sleep
+    static const int SPIN_ROUNDS = 64;
+
+    bool tryPush(const T& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while(true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            long dif = (long)seq - (long)pos;
+            if(dif == 0) {
+                if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if(dif < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while(true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            long dif = (long)seq - (long)(pos + 1);
+            if(dif == 0) {
+                if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if(dif < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->value;
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Retry done() for a while, then sleep on cv until it succeeds.  The
+    // sleeper count is raised before the last try, and read by wake() after
+    // the other side's push or pop, both with read-modify-writes: whichever
+    // comes second sees the first, so either the last try sees that push or
+    // pop or wake() sees the sleeper.
+    template <typename Done>
+    void waitFor(std::atomic<int>& sleepers, std::condition_variable& cv, Done done) {
+        for(int round = 0; round < SPIN_ROUNDS; ++round) {
+            std::this_thread::yield();
+            if(done()) return;
+        }
+        std::unique_lock<std::mutex> lock(waitMutex);
+        sleepers.fetch_add(1, std::memory_order_acq_rel);
+        cv.wait(lock, done);
+        sleepers.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void wake(std::atomic<int>& sleepers, std::condition_variable& cv) {
+        if(sleepers.fetch_add(0, std::memory_order_acq_rel) == 0) return;
+        std::lock_guard<std::mutex> lock(waitMutex);
+        cv.notify_all();
+    }
+
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+        Cell() : seq(0), value() {}
+        Cell(const Cell& other) : seq(other.seq.load(std::memory_order_relaxed)), value(other.value) {}
+    };
+
+    std::vector<Cell> cells;
+    size_t mask;
+    // producers and consumers claim positions on separate cache lines
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+    alignas(64) std::atomic<long> pushes;
+    std::atomic<long> occupancySum;
+    std::atomic<long> fullWaits;
+    std::atomic<long> emptyWaits;
+    // threads asleep in push and pop, and what they sleep on
+    alignas(64) std::atomic<int> fullSleepers;
+    std::atomic<int> emptySleepers;
+    std::mutex waitMutex;
+    std::condition_variable notFull, notEmpty;
+};
+
+#endif // BOUNDED_QUEUE_H
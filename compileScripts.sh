@@ -11,13 +11,21 @@ NC='\033[0m' # No Color
 # Custom filenames
 cpp_file="cpuSmithWaterman.cpp"
 cuda_file="smithWaterman.cu"
+split_file="splitPairs.cpp"
+extract_file="extractPairs.cpp"
+merge_file="mergeShards.cpp"
+client_file="swClient.cpp"
 cpu_binary="cpuSmithWaterman"
 gpu_binary="smithWaterman"
+split_binary="splitPairs"
+extract_binary="extractPairs"
+merge_binary="mergeShards"
+client_binary="swClient"
 
 # Compiler options
 cpp_compiler="g++"
 cuda_compiler="nvcc"
-cpp_flags="-O3 -std=c++11"
+cpp_flags="-O3 -std=c++11 -pthread"
 cuda_flags="-O3 -std=c++11"
 
 # Print header
@@ -36,6 +44,26 @@ if [ ! -f "$cuda_file" ]; then
     exit 1
 fi
 
+if [ ! -f "$split_file" ]; then
+    echo -e "${RED}Error: $split_file not found in current directory${NC}"
+    exit 1
+fi
+
+if [ ! -f "$extract_file" ]; then
+    echo -e "${RED}Error: $extract_file not found in current directory${NC}"
+    exit 1
+fi
+
+if [ ! -f "$merge_file" ]; then
+    echo -e "${RED}Error: $merge_file not found in current directory${NC}"
+    exit 1
+fi
+
+if [ ! -f "$client_file" ]; then
+    echo -e "${RED}Error: $client_file not found in current directory${NC}"
+    exit 1
+fi
+
 # Clean previous builds if they exist
 if [ -f "$cpu_binary" ]; then
     echo -e "${YELLOW}Removing previous CPU binary...${NC}"
@@ -47,6 +75,26 @@ if [ -f "$gpu_binary" ]; then
     rm "$gpu_binary"
 fi
 
+if [ -f "$split_binary" ]; then
+    echo -e "${YELLOW}Removing previous pair splitter binary...${NC}"
+    rm "$split_binary"
+fi
+
+if [ -f "$extract_binary" ]; then
+    echo -e "${YELLOW}Removing previous archive extractor binary...${NC}"
+    rm "$extract_binary"
+fi
+
+if [ -f "$merge_binary" ]; then
+    echo -e "${YELLOW}Removing previous shard merger binary...${NC}"
+    rm "$merge_binary"
+fi
+
+if [ -f "$client_binary" ]; then
+    echo -e "${YELLOW}Removing previous server client binary...${NC}"
+    rm "$client_binary"
+fi
+
 # Check for G++ compiler
 if ! command -v $cpp_compiler &> /dev/null; then
     echo -e "${RED}Error: $cpp_compiler compiler not found.${NC}"
@@ -72,6 +120,50 @@ else
     exit 1
 fi
 
+# Build pair splitter
+echo -e "${BLUE}Building pair splitter...${NC}"
+$cpp_compiler $cpp_flags -o $split_binary $split_file
+
+if [ $? -eq 0 ]; then
+    echo -e "${GREEN}Pair splitter build successful: $split_binary${NC}"
+else
+    echo -e "${RED}Pair splitter build failed${NC}"
+    exit 1
+fi
+
+# Build archive extractor
+echo -e "${BLUE}Building archive extractor...${NC}"
+$cpp_compiler $cpp_flags -o $extract_binary $extract_file
+
+if [ $? -eq 0 ]; then
+    echo -e "${GREEN}Archive extractor build successful: $extract_binary${NC}"
+else
+    echo -e "${RED}Archive extractor build failed${NC}"
+    exit 1
+fi
+
+# Build shard merger
+echo -e "${BLUE}Building shard merger...${NC}"
+$cpp_compiler $cpp_flags -o $merge_binary $merge_file
+
+if [ $? -eq 0 ]; then
+    echo -e "${GREEN}Shard merger build successful: $merge_binary${NC}"
+else
+    echo -e "${RED}Shard merger build failed${NC}"
+    exit 1
+fi
+
+# Build server client
+echo -e "${BLUE}Building server client...${NC}"
+$cpp_compiler $cpp_flags -o $client_binary $client_file
+
+if [ $? -eq 0 ]; then
+    echo -e "${GREEN}Server client build successful: $client_binary${NC}"
+else
+    echo -e "${RED}Server client build failed${NC}"
+    exit 1
+fi
+
 # Build GPU version
 echo -e "${BLUE}Building GPU implementation...${NC}"
 $cuda_compiler $cuda_flags -o $gpu_binary $cuda_file
@@ -87,10 +179,33 @@ echo ""
 echo -e "${GREEN}Both implementations built successfully!${NC}"
 echo -e "CPU binary: ${YELLOW}$cpu_binary${NC}"
 echo -e "GPU binary: ${YELLOW}$gpu_binary${NC}"
+echo -e "Pair splitter: ${YELLOW}$split_binary${NC}"
+echo -e "Archive extractor: ${YELLOW}$extract_binary${NC}"
+echo -e "Shard merger: ${YELLOW}$merge_binary${NC}"
+echo -e "Server client: ${YELLOW}$client_binary${NC}"
 echo ""
 echo -e "${BLUE}Usage:${NC}"
 echo -e "./$cpu_binary <seq1.fasta> <seq2.fasta>"
 echo -e "./$gpu_binary <seq1.fasta> <seq2.fasta>"
+echo -e "./$split_binary Sequences MSFs pairs.manifest"
+echo -e "./$cpu_binary -m pairs.manifest > pairs.msf"
+echo -e "./$cpu_binary -m pairs.manifest -o pairs.arc [--resume] [--pipeline 1:4:1]"
+echo -e "./$cpu_binary -m pairs.manifest -o pairs.arc --pipeline 1:8:1 --memory 4096"
+echo -e "./$cpu_binary -m pairs.manifest -o pairs.arc --dedup"
+echo -e "./$cpu_binary -m pairs.manifest -o hits.arc --min-score 40"
+echo -e "./$cpu_binary -m pairs.manifest -o best.arc --two-phase --top 100"
+echo -e "./$extract_binary pairs.arc -d MSF_Output"
+echo -e "./$cpu_binary -m pairs.manifest -o shard0.arc --shard 0/2"
+echo -e "./$merge_binary pairs.manifest pairs.arc shard0.arc shard1.arc"
+echo -e "./$cpu_binary -s /tmp/sw.sock &"
+echo -e "./$client_binary /tmp/sw.sock <seq1.fasta> <seq2.fasta>"
+echo -e "./$cpu_binary -M Sequences/BB11001.tfa > BB11001.msf"
+echo -e "./$cpu_binary --all-vs-all Sequences/BB11001.tfa BB11001.scores"
+echo -e "./$cpu_binary -p MSFs/BB11001.msf <seq.fasta> [<seq.fasta> ...]"
+echo -e "./$cpu_binary --out-of-core /tmp <seq1.fasta> <seq2.fasta>"
+echo -e "./$cpu_binary --both-strands <query.fasta> <target.fasta> [<target.fasta> ...]"
+echo -e "./$cpu_binary --check -n 100000 -c check.corpus"
+echo -e "./$cpu_binary --autotune host.tuning && ./$cpu_binary --tuning host.tuning -m pairs.manifest"
 echo ""
 echo -e "${BLUE}For benchmarking:${NC}"
 echo -e "time ./$cpu_binary <seq1.fasta> <seq2.fasta> > cpu_result.txt"
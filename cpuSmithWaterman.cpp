@@ -5,8 +5,40 @@
 #include <cctype>
 #include <cstdio>
 #include <algorithm>
+#include <set>
+#include <map>
+#include <deque>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <cerrno>
+#include <csignal>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <random>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <chrono>  // For timing
 #include <iomanip>  // For std::setprecision
+#include "pairManifest.h"
+#include "pairArchive.h"
+#include "alignProtocol.h"
+#include "boundedQueue.h"
+#include "threadPlacement.h"
+#include "progressiveAlign.h"
+#include "msfProfile.h"
+#include "engineCheck.h"
+#include "alphabetKernels.h"
+#include "directionSpill.h"
+#include "tuningProfile.h"
+#include "memoryBudget.h"
+#include "sequenceDedup.h"
+#include "scoreTable.h"
 
 // Helper function to extract base name without directory or extension
 std::string extractBaseName(const std::string& filepath) {
@@ -31,13 +63,8 @@ std::string stripPrefix(const std::string& name) {
     return name;
 }
 
-// Read a sequence from a FASTA file
-bool readFastaFile(const std::string& filename, std::string& name, std::string& seq) {
-    std::ifstream fin(filename);
-    if(!fin.is_open()) {
-        return false;
-    }
-    
+// Read a sequence from FASTA text
+bool readFasta(std::istream& fin, std::string& name, std::string& seq) {
     std::string line;
     name = "";
     seq = "";
@@ -63,11 +90,24 @@ bool readFastaFile(const std::string& filename, std::string& name, std::string&
             }
         }
     }
-    
-    fin.close();
     return true;
 }
 
+// Read a sequence from a FASTA file
+bool readFastaFile(const std::string& filename, std::string& name, std::string& seq) {
+    std::ifstream fin(filename);
+    if(!fin.is_open()) {
+        return false;
+    }
+    return readFasta(fin, name, seq);
+}
+
+// Name a sequence for the MSF output: its FASTA name, or the base name of
+// its file if the header has none, without any family prefix
+std::string sequenceName(const std::string& name, const std::string& filepath) {
+    return stripPrefix(name.empty() ? extractBaseName(filepath) : name);
+}
+
 // Convert a sequence to uppercase
 void toUpperCase(std::string& seq) {
     for(char &c : seq) {
@@ -75,69 +115,187 @@ void toUpperCase(std::string& seq) {
     }
 }
 
-// Perform Smith-Waterman alignment
-void smithWaterman(const std::string& seq1, const std::string& seq2, 
-                  int matchScore, int mismatchScore, int gapScore,
-                  std::string& align1, std::string& align2, int& maxScore) {
-    int len1 = seq1.length();
-    int len2 = seq2.length();
+// Score and direction matrices, kept between alignments so a long-lived
+// caller does not allocate them for every pair
+struct AlignWorkspace {
+    std::vector<int> score;
+    std::vector<unsigned char> dir;
+    std::vector<unsigned char> codes1;      // seq1 symbols, packed, for the alphabet kernels
+    std::vector<signed char> profile;       // and their query profile over seq2
+    int endI, endJ;     // cell the last traceback started from
     
-    // Allocate score and direction matrices
-    std::vector<int> score((len1+1) * (len2+1), 0);
-    std::vector<unsigned char> dir((len1+1) * (len2+1), 0);
+    // With a minimum score, smithWaterman gives up on a pair as soon as an
+    // upper bound on its score falls below it: maxScore is then the bound,
+    // and the aligned strings are empty
+    int minScore;                   // INT_MIN to align every pair in full
+    int bestSubstitution;           // highest substitution score, for the bounds
+    long long prunedCells;          // cells left unfilled, over all pairs
     
-    // Fill the matrices
-    for(int i = 1; i <= len1; ++i) {
-        for(int j = 1; j <= len2; ++j) {
-            // Compute scores for match/mismatch and gap options
-            int up   = score[(i-1) * (len2+1) + j] + gapScore;
-            int left = score[i * (len2+1) + (j-1)] + gapScore;
-            int diagScore = score[(i-1) * (len2+1) + (j-1)] + 
-                           ((seq1[i-1] == seq2[j-1]) ? matchScore : mismatchScore);
-            
-            // Choose the maximum, compare with 0 for local alignment
-            int localMaxScore = 0;
-            unsigned char direction = 0;
-            if(diagScore > localMaxScore) {
-                localMaxScore = diagScore;
-                direction = 1; // 1 = diagonal
-            }
-            if(up > localMaxScore) {
-                localMaxScore = up;
-                direction = 2; // 2 = up (gap in seq2)
-            }
-            if(left > localMaxScore) {
-                localMaxScore = left;
-                direction = 3; // 3 = left (gap in seq1)
+    AlignWorkspace() : endI(0), endJ(0), minScore(INT_MIN), bestSubstitution(0), prunedCells(0) {}
+    
+    // Free the matrices and profile, keeping the settings and counts
+    void releaseBuffers() {
+        std::vector<int>().swap(score);
+        std::vector<unsigned char>().swap(dir);
+        std::vector<unsigned char>().swap(codes1);
+        std::vector<signed char>().swap(profile);
+    }
+};
+
+// Alignment modes sharing the DP engine.  Local is Smith-Waterman; the
+// others align the full length of the sequences, with end gaps free on both
+// (semi-global), on seq2 only (glocal: seq1 placed anywhere in seq2), or on
+// neither (global, Needleman-Wunsch).
+enum AlignMode { LOCAL_ALIGNMENT, GLOBAL_ALIGNMENT, SEMIGLOBAL_ALIGNMENT, GLOCAL_ALIGNMENT };
+
+bool parseAlignMode(const std::string& name, AlignMode& mode) {
+    if(name == "local") mode = LOCAL_ALIGNMENT;
+    else if(name == "global") mode = GLOBAL_ALIGNMENT;
+    else if(name == "semiglobal") mode = SEMIGLOBAL_ALIGNMENT;
+    else if(name == "glocal") mode = GLOCAL_ALIGNMENT;
+    else return false;
+    return true;
+}
+
+// Parse a whole signed score such as a --min-score; INT_MIN is kept for "none"
+bool parseScore(const std::string& text, int& score) {
+    char *end;
+    errno = 0;
+    long value = std::strtol(text.c_str(), &end, 10);
+    if(text.empty() || *end != '\0' || errno != 0 || value <= INT_MIN || value > INT_MAX) return false;
+    score = value;
+    return true;
+}
+
+const char *alignModeName(AlignMode mode) {
+    static const char *names[] = { "local", "global", "semiglobal", "glocal" };
+    return names[mode];
+}
+
+// Size the matrices for seq1 x seq2 and set row 0 and column 0, the only
+// cells the fill loop does not write.  Leading gaps cost nothing in local
+// mode and on the sequences whose end gaps are free.
+void prepareDP(int len1, int len2, int gapScore, AlignMode mode, AlignWorkspace& ws) {
+    size_t cells = (size_t)(len1+1) * (len2+1);
+    // sized apart: the score-only engine grows score alone
+    if(ws.score.size() < cells) ws.score.resize(cells);
+    if(ws.dir.size() < cells) ws.dir.resize(cells);
+    int *score = ws.score.data();
+    bool freeGaps1 = mode == LOCAL_ALIGNMENT || mode == SEMIGLOBAL_ALIGNMENT;
+    bool freeGaps2 = freeGaps1 || mode == GLOCAL_ALIGNMENT;
+    for(int j = 0; j <= len2; ++j) score[j] = freeGaps2 ? 0 : j * gapScore;
+    for(int i = 1; i <= len1; ++i) score[(size_t)i * (len2+1)] = freeGaps1 ? 0 : i * gapScore;
+}
+
+// Local alignment never goes below 0; the other modes have no floor
+inline int floorScoreFor(AlignMode mode) {
+    return (mode == LOCAL_ALIGNMENT) ? 0 : INT_MIN / 2;
+}
+
+// Choose a cell's score from the moves into it, diagonal, up and left, and
+// return its direction; ties go to diagonal, then up, then left
+inline unsigned char chooseMove(int diagScore, int up, int left, int floorScore, int& cellScore) {
+    // Choose the maximum, compare with 0 for local alignment
+    int localMaxScore = floorScore;
+    unsigned char direction = 0;
+    if(diagScore > localMaxScore) {
+        localMaxScore = diagScore;
+        direction = 1; // 1 = diagonal
+    }
+    if(up > localMaxScore) {
+        localMaxScore = up;
+        direction = 2; // 2 = up (gap in seq2)
+    }
+    if(left > localMaxScore) {
+        localMaxScore = left;
+        direction = 3; // 3 = left (gap in seq1)
+    }
+    cellScore = localMaxScore;
+    return direction;
+}
+
+// Fill cell j of a row from the row above it and return its direction
+inline unsigned char fillCell(const int *above, int *row, int j,
+                              int substitution, int gapScore, int floorScore) {
+    // Compute scores for match/mismatch and gap options; the caller stores
+    // the direction
+    return chooseMove(above[j-1] + substitution, above[j] + gapScore, row[j-1] + gapScore,
+                      floorScore, row[j]);
+}
+
+// Fill cells 1 to len2 of a row from the row above it, and their
+// directions in rowDir, with local mode's floor or the others' fixed at
+// compile time.  The neighbours are carried in locals: the direction
+// stores could alias the scores, so reading them back from the rows would
+// cost a load per cell.
+template <bool LOCAL, typename SubstitutionRow>
+inline void fillRow(const int *above, int *row, unsigned char *rowDir, int len2,
+                    SubstitutionRow substitution, int gapScore) {
+    const int floorScore = LOCAL ? 0 : INT_MIN / 2;
+    int diag = above[0], left = row[0];
+    for(int j = 1; j <= len2; ++j) {
+        int up = above[j];
+        unsigned char direction = chooseMove(diag + substitution(j-1), up + gapScore, left + gapScore,
+                                             floorScore, left);
+        row[j] = left;
+        rowDir[j] = direction;
+        diag = up;
+    }
+}
+
+// End cell of a full-length alignment: the corner, or the best cell of the
+// last row or column where end gaps are free.  scoreAt(i, j) need only
+// answer for the last row and column.
+template <typename ScoreAt>
+void findFullLengthEnd(int len1, int len2, AlignMode mode, ScoreAt scoreAt,
+                       int& maxScore, int& max_i, int& max_j) {
+    bool freeGaps1 = mode == LOCAL_ALIGNMENT || mode == SEMIGLOBAL_ALIGNMENT;
+    bool freeGaps2 = freeGaps1 || mode == GLOCAL_ALIGNMENT;
+    max_i = len1;
+    max_j = len2;
+    maxScore = scoreAt(len1, len2);
+    if(freeGaps2) {
+        for(int j = 0; j <= len2; ++j) {
+            if(scoreAt(len1, j) > maxScore) {
+                maxScore = scoreAt(len1, j);
+                max_j = j;
             }
-            
-            // Store score and direction
-            score[i * (len2+1) + j] = localMaxScore;
-            dir[i * (len2+1) + j] = direction;
         }
     }
-    
-    // Find the cell with maximum score
-    maxScore = 0;
-    int max_i = 0, max_j = 0;
-    for(int i = 1; i <= len1; ++i) {
-        for(int j = 1; j <= len2; ++j) {
-            int val = score[i * (len2+1) + j];
-            if(val > maxScore) {
-                maxScore = val;
+    if(freeGaps1) {
+        for(int i = 0; i <= len1; ++i) {
+            if(scoreAt(i, len2) > maxScore) {
+                maxScore = scoreAt(i, len2);
                 max_i = i;
-                max_j = j;
+                max_j = len2;
             }
         }
     }
-    
-    // Traceback from (max_i, max_j) until score becomes 0
+}
+
+// Trace the alignment back from (ti, tj), reading directions with
+// dirAt(i, j).  A local alignment stops at a cell with direction 0, which is
+// exactly a cell scoring 0; full-length modes first put the trailing
+// residues past the end cell against gaps, and finish on row 0 or column 0.
+template <typename DirAt>
+void traceback(const std::string& seq1, const std::string& seq2, AlignMode mode,
+               int ti, int tj, DirAt dirAt, std::string& align1, std::string& align2) {
+    int len1 = seq1.length();
+    int len2 = seq2.length();
     align1 = "";
     align2 = "";
-    int ti = max_i;
-    int tj = max_j;
+    if(mode != LOCAL_ALIGNMENT) {
+        for(int i = len1; i > ti; --i) {
+            align1.push_back(seq1[i-1]);
+            align2.push_back('-');
+        }
+        for(int j = len2; j > tj; --j) {
+            align1.push_back('-');
+            align2.push_back(seq2[j-1]);
+        }
+    }
     while(ti > 0 && tj > 0) {
-        unsigned char d = dir[ti * (len2+1) + tj];
+        unsigned char d = dirAt(ti, tj);
         if(d == 0) {
             break; // alignment stop
         }
@@ -158,9 +316,18 @@ void smithWaterman(const std::string& seq1, const std::string& seq2,
             // Should not happen for Smith-Waterman (d is 0-3)
             break;
         }
-        if(score[ti * (len2+1) + tj] == 0) {
-            // Stop when we hit a cell with 0 (beginning of local alignment)
-            break;
+    }
+    
+    // Full-length modes reach row 0 or column 0; the leading residues left
+    // over go against gaps, which is also the path the border scores describe
+    if(mode != LOCAL_ALIGNMENT) {
+        for(; ti > 0; --ti) {
+            align1.push_back(seq1[ti-1]);
+            align2.push_back('-');
+        }
+        for(; tj > 0; --tj) {
+            align1.push_back('-');
+            align2.push_back(seq2[tj-1]);
         }
     }
     
@@ -177,6 +344,544 @@ void smithWaterman(const std::string& seq1, const std::string& seq2,
     }
 }
 
+// Pick the end cell of a filled matrix and trace the alignment back from it
+void finishDP(const std::string& seq1, const std::string& seq2, AlignMode mode,
+              std::string& align1, std::string& align2, int& maxScore,
+              AlignWorkspace& ws) {
+    int len1 = seq1.length();
+    int len2 = seq2.length();
+    const int *score = ws.score.data();
+    const unsigned char *dir = ws.dir.data();
+    size_t rowCells = (size_t)len2 + 1;
+    
+    // Find the cell with maximum score: anywhere for local alignment, else
+    // the corner, or anywhere in the last row or column where end gaps are
+    // free
+    maxScore = 0;
+    int max_i = 0, max_j = 0;
+    if(mode == LOCAL_ALIGNMENT) {
+        for(int i = 1; i <= len1; ++i) {
+            for(int j = 1; j <= len2; ++j) {
+                int val = score[i * rowCells + j];
+                if(val > maxScore) {
+                    maxScore = val;
+                    max_i = i;
+                    max_j = j;
+                }
+            }
+        }
+    } else {
+        findFullLengthEnd(len1, len2, mode, [&](int i, int j) { return score[i * rowCells + j]; },
+                          maxScore, max_i, max_j);
+    }
+    ws.endI = max_i;
+    ws.endJ = max_j;
+    if(maxScore < ws.minScore) {
+        align1.clear();
+        align2.clear();
+        return;
+    }
+    traceback(seq1, seq2, mode, max_i, max_j, [&](int i, int j) { return dir[i * rowCells + j]; },
+              align1, align2);
+}
+
+// With a minimum score, the final score is bounded after every row i: by
+// the best end already filled (anywhere for local, in the last column for
+// semi-global; kept in bestEnd), or a path through this row's best cell
+// matching every residue left.  Free leading gaps make that cell at least 0,
+// which also covers paths starting below the row.  Gaps must cost, for it
+// to hold.
+inline long long scoreBoundAfterRow(const int *row, int i, int len1, int len2, AlignMode mode,
+                                    int bestSubstitution, long long& bestEnd) {
+    int rowMax = *std::max_element(row, row + len2 + 1);
+    if(mode == LOCAL_ALIGNMENT) bestEnd = std::max(bestEnd, (long long)rowMax);
+    else if(mode == SEMIGLOBAL_ALIGNMENT) bestEnd = std::max(bestEnd, (long long)row[len2]);
+    return std::max(bestEnd, rowMax + (long long)bestSubstitution * std::min(len1 - i, len2));
+}
+
+// A row of substitution scores, for one residue of seq1 against each of
+// seq2: by comparing bytes, or read from a query profile
+struct ByteCompareRow {
+    char residue;
+    const char *seq2;
+    int matchScore, mismatchScore;
+    int operator()(int j) const { return residue == seq2[j] ? matchScore : mismatchScore; }
+};
+
+struct ProfileRow {
+    const signed char *scores;
+    int operator()(int j) const { return scores[j]; }
+};
+
+// Fill the matrices prepareDP sized, in the loop for local mode or for the
+// others.  substitutionRow(i) gives the scores of position i of seq1 against
+// seq2, called with a position of seq2.  False, with the bound in maxScore,
+// if the pair falls below the minimum score partway.
+template <bool LOCAL, typename SubstitutionRow>
+bool fillDP(int len1, int len2, SubstitutionRow substitutionRow, int gapScore, AlignMode mode,
+            int& maxScore, AlignWorkspace& ws) {
+    int *score = ws.score.data();
+    unsigned char *dir = ws.dir.data();
+    const bool pruning = ws.minScore > INT_MIN && gapScore <= 0;
+    long long bestEnd = INT_MIN;
+    
+    size_t rowCells = (size_t)len2 + 1;
+    for(int i = 1; i <= len1; ++i) {
+        int *row = score + i * rowCells;
+        unsigned char *rowDir = dir + i * rowCells;
+        fillRow<LOCAL>(row - rowCells, row, rowDir, len2, substitutionRow(i-1), gapScore);
+        if(pruning) {
+            long long bound = scoreBoundAfterRow(row, i, len1, len2, mode, ws.bestSubstitution, bestEnd);
+            if(bound < ws.minScore) {
+                ws.prunedCells += (long long)(len1 - i) * len2;
+                ws.endI = ws.endJ = 0;
+                maxScore = bound;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// DP engine shared by the sequence and profile kernels: substitutionRow(i)
+// scores position i of seq1, a residue or a profile column, against the
+// positions of seq2 (see fillDP)
+template <typename SubstitutionRow>
+void alignDP(const std::string& seq1, const std::string& seq2, 
+             SubstitutionRow substitutionRow, int gapScore, AlignMode mode,
+             std::string& align1, std::string& align2, int& maxScore,
+             AlignWorkspace& ws) {
+    int len1 = seq1.length();
+    int len2 = seq2.length();
+    prepareDP(len1, len2, gapScore, mode, ws);
+    bool filled = mode == LOCAL_ALIGNMENT
+        ? fillDP<true>(len1, len2, substitutionRow, gapScore, mode, maxScore, ws)
+        : fillDP<false>(len1, len2, substitutionRow, gapScore, mode, maxScore, ws);
+    if(!filled) {
+        align1.clear();
+        align2.clear();
+        return;
+    }
+    finishDP(seq1, seq2, mode, align1, align2, maxScore, ws);
+}
+
+// Align by comparing residue bytes; any alphabet, and the reference the
+// alphabet kernels are checked against
+void alignGeneral(const std::string& seq1, const std::string& seq2, 
+                  int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                  std::string& align1, std::string& align2, int& maxScore,
+                  AlignWorkspace& ws) {
+    alignDP(seq1, seq2, [&](int i) { return ByteCompareRow{seq1[i], seq2.data(), matchScore, mismatchScore}; },
+            gapScore, mode, align1, align2, maxScore, ws);
+}
+
+// Directions are spilled in tiles of this many bytes
+const size_t SPILL_TILE_BYTES = 64u << 20;
+
+// Align with two rows of scores in memory and the direction matrix spilled
+// to a temporary file in spillDir (see directionSpill.h), for pairs whose
+// matrices do not fit in memory.  Same result as alignGeneral; false with
+// the reason in error if the file cannot be made.
+bool alignOutOfCore(const std::string& seq1, const std::string& seq2,
+                    int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                    const std::string& spillDir, size_t tileBytes,
+                    std::string& align1, std::string& align2, int& maxScore,
+                    int& endI, int& endJ, std::string& error) {
+    int len1 = seq1.length();
+    int len2 = seq2.length();
+    DirectionSpill spill;
+    if(!spill.open(spillDir, len1, len2, tileBytes, error)) return false;
+    
+    bool freeGaps1 = mode == LOCAL_ALIGNMENT || mode == SEMIGLOBAL_ALIGNMENT;
+    bool freeGaps2 = freeGaps1 || mode == GLOCAL_ALIGNMENT;
+    const int floorScore = floorScoreFor(mode);
+    std::vector<int> above(len2+1), row(len2+1), lastColumn(len1+1);
+    for(int j = 0; j <= len2; ++j) above[j] = freeGaps2 ? 0 : j * gapScore;
+    lastColumn[0] = above[len2];
+    
+    // Fill row by row, keeping the best cell as a local alignment's end
+    maxScore = 0;
+    endI = endJ = 0;
+    for(int i = 1; i <= len1; ++i) {
+        unsigned char *packed = spill.row(i-1);
+        if(!packed) {
+            error = "unable to map the direction file";
+            return false;
+        }
+        row[0] = freeGaps1 ? 0 : i * gapScore;
+        for(int j = 1; j <= len2; ++j) {
+            int substitution = seq1[i-1] == seq2[j-1] ? matchScore : mismatchScore;
+            DirectionSpill::set(packed, j-1, fillCell(above.data(), row.data(), j, substitution,
+                                                      gapScore, floorScore));
+            if(mode == LOCAL_ALIGNMENT && row[j] > maxScore) {
+                maxScore = row[j];
+                endI = i;
+                endJ = j;
+            }
+        }
+        lastColumn[i] = row[len2];
+        above.swap(row);
+    }
+    
+    // above now holds the last row
+    if(mode != LOCAL_ALIGNMENT) {
+        findFullLengthEnd(len1, len2, mode,
+                          [&](int i, int j) { return i == len1 ? above[j] : lastColumn[i]; },
+                          maxScore, endI, endJ);
+    }
+    bool mapped = true;
+    traceback(seq1, seq2, mode, endI, endJ, [&](int i, int j) {
+        const unsigned char *packed = spill.row(i-1);
+        if(!packed) {
+            mapped = false;
+            return (unsigned char)0;
+        }
+        return DirectionSpill::get(packed, j-1);
+    }, align1, align2);
+    if(!mapped) error = "unable to map the direction file";
+    return mapped;
+}
+
+// Engine choices loaded with --tuning, read-only once main has set it
+const TuningProfile *activeTuning = NULL;
+
+// Where out-of-core alignments put their direction files
+std::string spillDirectory() {
+    const char *tmp = std::getenv("TMPDIR");
+    return tmp ? tmp : "/tmp";
+}
+
+// The engine smithWaterman runs a len1 x len2 pair of the alphabet on, and
+// its tile size if that is the out-of-core engine; the byte compare when
+// the scores do not fit a query profile
+TunedEngine chooseEngine(SequenceAlphabet alphabet, size_t len1, size_t len2,
+                         int matchScore, int mismatchScore, size_t& tileBytes) {
+    const TuningRule *rule = activeTuning ? activeTuning->lookup(alphabet, (long long)(len1 * len2)) : NULL;
+    tileBytes = rule ? rule->tileBytes : 0;
+    if(rule && rule->engine != ALPHABET_ENGINE) return rule->engine;
+    if(alphabet == GENERAL_ALPHABET || !profileHolds(matchScore, mismatchScore)) return GENERAL_ENGINE;
+    return ALPHABET_ENGINE;
+}
+
+// Estimated bytes the engine holds while aligning a len1 x len2 pair: the
+// score and direction matrices, plus the query profile for the alphabet
+// kernels, or two rows, the last column and one mapped tile out of core;
+// the aligned strings either way
+size_t pairWorkingSet(SequenceAlphabet alphabet, TunedEngine engine, size_t tileBytes,
+                      size_t len1, size_t len2) {
+    size_t bytes = 2 * (len1 + len2);
+    if(engine == OUT_OF_CORE_ENGINE) {
+        size_t fileBytes = len1 * ((len2 + 3) / 4);
+        return bytes + (2 * (len2 + 1) + len1 + 1) * sizeof(int) + std::min(tileBytes, fileBytes);
+    }
+    bytes += (len1 + 1) * (len2 + 1) * (sizeof(int) + 1);
+    if(engine == ALPHABET_ENGINE) {
+        const AlphabetCodes& codes = alphabetCodes(alphabet);
+        bytes += (len1 * codes.bits + 7) / 8 + codes.symbols * len2;
+    }
+    return bytes;
+}
+
+// Skip a pair before aligning it if, with a minimum score set in ws, even a
+// match per residue of the shorter sequence falls short of it
+bool pruneBeforeDP(const std::string& seq1, const std::string& seq2, int matchScore, int mismatchScore,
+                   int gapScore, std::string& align1, std::string& align2, int& maxScore, AlignWorkspace& ws) {
+    ws.bestSubstitution = std::max(0, std::max(matchScore, mismatchScore));
+    long long bound = (long long)ws.bestSubstitution * std::min(seq1.size(), seq2.size());
+    if(ws.minScore == INT_MIN || gapScore > 0 || bound >= ws.minScore) return false;
+    ws.prunedCells += (long long)seq1.size() * seq2.size();
+    ws.endI = ws.endJ = 0;
+    maxScore = bound;
+    align1.clear();
+    align2.clear();
+    return true;
+}
+
+// Perform Smith-Waterman alignment, or one of the full-length modes, with
+// the kernel for the pair's alphabet (see alphabetKernels.h), or the engine
+// the tuning profile chose for pairs of its alphabet and size
+void smithWaterman(const std::string& seq1, const std::string& seq2, 
+                  int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                  std::string& align1, std::string& align2, int& maxScore,
+                  AlignWorkspace& ws) {
+    if(pruneBeforeDP(seq1, seq2, matchScore, mismatchScore, gapScore, align1, align2, maxScore, ws)) return;
+    SequenceAlphabet alphabet = pairAlphabet(seq1, seq2);
+    size_t tileBytes;
+    TunedEngine engine = chooseEngine(alphabet, seq1.size(), seq2.size(), matchScore, mismatchScore, tileBytes);
+    if(engine == OUT_OF_CORE_ENGINE) {
+        std::string error;
+        if(alignOutOfCore(seq1, seq2, matchScore, mismatchScore, gapScore, mode, spillDirectory(),
+                          tileBytes, align1, align2, maxScore, ws.endI, ws.endJ, error)) {
+            return;
+        }
+    }
+    if(alphabet == GENERAL_ALPHABET || engine == GENERAL_ENGINE) {
+        alignGeneral(seq1, seq2, matchScore, mismatchScore, gapScore, mode, align1, align2, maxScore, ws);
+        return;
+    }
+    const AlphabetCodes& codes = alphabetCodes(alphabet);
+    encodeSequence(seq1, codes, ws.codes1);
+    buildQueryProfile(seq2, codes, matchScore, mismatchScore, ws.profile);
+    const unsigned char *codes1 = ws.codes1.data();
+    const signed char *profile = ws.profile.data();
+    size_t len2 = seq2.size();
+    int bits = codes.bits;
+    alignDP(seq1, seq2, [=](int i) { return ProfileRow{profile + symbolAt(codes1, i, bits) * len2}; },
+            gapScore, mode, align1, align2, maxScore, ws);
+}
+
+void smithWaterman(const std::string& seq1, const std::string& seq2, 
+                  int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                  std::string& align1, std::string& align2, int& maxScore) {
+    AlignWorkspace ws;
+    smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode, align1, align2, maxScore, ws);
+}
+
+// Score-only DP: the same fill as alignDP on two rows of ws.score, keeping
+// the last column for the full-length modes, and no directions past the
+// row.  Finds the score and end cell the full engine would, in linear
+// memory; with a minimum score it gives up as alignDP does.
+template <bool LOCAL, typename SubstitutionRow>
+void scoreOnlyFill(int len1, int len2, SubstitutionRow substitutionRow, int gapScore, AlignMode mode,
+                   int& maxScore, AlignWorkspace& ws) {
+    size_t rowCells = (size_t)len2 + 1;
+    if(ws.score.size() < 2 * rowCells + len1 + 1) ws.score.resize(2 * rowCells + len1 + 1);
+    int *above = ws.score.data();
+    int *row = above + rowCells;
+    int *lastColumn = row + rowCells;
+    if(ws.dir.size() < rowCells) ws.dir.resize(rowCells);
+    unsigned char *rowDir = ws.dir.data();     // directions, overwritten row by row
+    bool freeGaps1 = mode == LOCAL_ALIGNMENT || mode == SEMIGLOBAL_ALIGNMENT;
+    bool freeGaps2 = freeGaps1 || mode == GLOCAL_ALIGNMENT;
+    const bool pruning = ws.minScore > INT_MIN && gapScore <= 0;
+    long long bestEnd = INT_MIN;
+    for(int j = 0; j <= len2; ++j) above[j] = freeGaps2 ? 0 : j * gapScore;
+    lastColumn[0] = above[len2];
+    
+    maxScore = 0;
+    ws.endI = ws.endJ = 0;
+    for(int i = 1; i <= len1; ++i) {
+        row[0] = freeGaps1 ? 0 : i * gapScore;
+        fillRow<LOCAL>(above, row, rowDir, len2, substitutionRow(i-1), gapScore);
+        lastColumn[i] = row[len2];
+        
+        // The first best cell of the row, scanned apart so the fill stays tight
+        if(LOCAL && len2 > 0) {
+            const int *best = std::max_element(row + 1, row + len2 + 1);
+            if(*best > maxScore) {
+                maxScore = *best;
+                ws.endI = i;
+                ws.endJ = best - row;
+            }
+        }
+        if(pruning) {
+            long long bound = scoreBoundAfterRow(row, i, len1, len2, mode, ws.bestSubstitution, bestEnd);
+            if(bound < ws.minScore) {
+                ws.prunedCells += (long long)(len1 - i) * len2;
+                ws.endI = ws.endJ = 0;
+                maxScore = bound;
+                return;
+            }
+        }
+        std::swap(above, row);
+    }
+    
+    // above now holds the last row
+    if(!LOCAL) {
+        findFullLengthEnd(len1, len2, mode, [&](int i, int j) { return i == len1 ? above[j] : lastColumn[i]; },
+                          maxScore, ws.endI, ws.endJ);
+    }
+}
+
+// scoreOnlyFill in the loop for the pair's mode
+template <typename SubstitutionRow>
+void scoreOnlyDP(int len1, int len2, SubstitutionRow substitutionRow, int gapScore, AlignMode mode,
+                 int& maxScore, AlignWorkspace& ws) {
+    if(mode == LOCAL_ALIGNMENT) scoreOnlyFill<true>(len1, len2, substitutionRow, gapScore, mode, maxScore, ws);
+    else scoreOnlyFill<false>(len1, len2, substitutionRow, gapScore, mode, maxScore, ws);
+}
+
+// Score a pair without aligning it, with the kernel smithWaterman would use
+// for its alphabet; the end cell is left in ws.endI and ws.endJ
+void scorePair(const std::string& seq1, const std::string& seq2,
+               int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+               int& maxScore, AlignWorkspace& ws) {
+    std::string none1, none2;
+    if(pruneBeforeDP(seq1, seq2, matchScore, mismatchScore, gapScore, none1, none2, maxScore, ws)) return;
+    int len1 = seq1.length();
+    int len2 = seq2.length();
+    SequenceAlphabet alphabet = pairAlphabet(seq1, seq2);
+    if(alphabet == GENERAL_ALPHABET || !profileHolds(matchScore, mismatchScore)) {
+        scoreOnlyDP(len1, len2, [&](int i) { return ByteCompareRow{seq1[i], seq2.data(), matchScore, mismatchScore}; },
+                    gapScore, mode, maxScore, ws);
+        return;
+    }
+    const AlphabetCodes& codes = alphabetCodes(alphabet);
+    encodeSequence(seq1, codes, ws.codes1);
+    buildQueryProfile(seq2, codes, matchScore, mismatchScore, ws.profile);
+    const unsigned char *codes1 = ws.codes1.data();
+    const signed char *profile = ws.profile.data();
+    int bits = codes.bits;
+    scoreOnlyDP(len1, len2, [=](int i) { return ProfileRow{profile + symbolAt(codes1, i, bits) * (size_t)len2}; },
+                gapScore, mode, maxScore, ws);
+}
+
+// Align a pair that scorePair gave maxScore, ending at (endI, endJ).  A
+// local alignment lies between that end and the furthest start that can
+// still reach maxScore from it, which a reverse score-only pass finds; only
+// that rectangle is aligned.  Scores in the rectangle never exceed those of
+// the whole matrix and equal them along the traced path, so the end cell,
+// every direction on the path and the start come out the same, and so does
+// the alignment.  The full-length modes are aligned over the whole matrix.
+// Returns the cells the DP filled.
+long long alignDeferred(const std::string& seq1, const std::string& seq2,
+                        int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                        int maxScore, int endI, int endJ,
+                        std::string& align1, std::string& align2, AlignWorkspace& ws) {
+    int score;
+    if(mode != LOCAL_ALIGNMENT) {
+        smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode, align1, align2, score, ws);
+        return (long long)seq1.size() * seq2.size();
+    }
+    if(maxScore <= 0) {
+        align1.clear();
+        align2.clear();
+        ws.endI = ws.endJ = 0;
+        return 0;
+    }
+    
+    // Reverse pass anchored at the end: G(i, j) is the best score of a path
+    // from cell (endI - i, endJ - j) to the end, which is at most maxScore
+    int best = std::max(0, std::max(matchScore, mismatchScore));
+    std::vector<int> above(endJ + 1), row(endJ + 1);
+    for(int j = 0; j <= endJ; ++j) above[j] = j * gapScore;
+    int top = endI, left = endJ;
+    long long cells = 0;
+    for(int i = 1; i <= endI; ++i) {
+        row[0] = i * gapScore;
+        int rowMax = row[0];
+        for(int j = 1; j <= endJ; ++j) {
+            int substitution = seq1[endI - i] == seq2[endJ - j] ? matchScore : mismatchScore;
+            row[j] = std::max(above[j-1] + substitution, std::max(above[j], row[j-1]) + gapScore);
+            if(row[j] == maxScore) {
+                top = std::min(top, endI - i);
+                left = std::min(left, endJ - j);
+            }
+            rowMax = std::max(rowMax, row[j]);
+        }
+        cells += endJ;
+        if(rowMax + (long long)best * (endI - i) < maxScore) break;
+        above.swap(row);
+    }
+    
+    smithWaterman(seq1.substr(top, endI - top), seq2.substr(left, endJ - left), matchScore, mismatchScore,
+                  gapScore, mode, align1, align2, score, ws);
+    ws.endI += top;
+    ws.endJ += left;
+    return cells + (long long)(endI - top) * (endJ - left);
+}
+
+// Reverse complement of a nucleotide sequence; U pairs as T does, and
+// anything but A, C, G, T, U is kept as it is
+std::string reverseComplement(const std::string& seq) {
+    std::string rc(seq.rbegin(), seq.rend());
+    for(char &c : rc) {
+        switch(c) {
+        case 'A': c = 'T'; break;
+        case 'C': c = 'G'; break;
+        case 'G': c = 'C'; break;
+        case 'T': case 'U': c = 'A'; break;
+        }
+    }
+    return rc;
+}
+
+bool isNucleotide(const std::string& seq) {
+    return seq.find_first_not_of("ACGTUN") == std::string::npos;
+}
+
+// A nucleotide query to be searched on both strands: the strands, and their
+// symbols for the DNA kernel, made once for all targets
+struct StrandQuery {
+    std::string strand[2];                  // forward, reverse complement
+    std::vector<unsigned char> codes[2];
+    bool encoded;                           // pure ACGT
+};
+
+StrandQuery makeStrandQuery(const std::string& query) {
+    StrandQuery q;
+    q.strand[0] = query;
+    q.strand[1] = reverseComplement(query);
+    q.encoded = detectAlphabet(query) == DNA_ALPHABET;
+    if(q.encoded) {
+        for(int s = 0; s < 2; ++s) encodeSequence(q.strand[s], alphabetCodes(DNA_ALPHABET), q.codes[s]);
+    }
+    return q;
+}
+
+struct StrandHit {
+    std::string align1, align2;
+    int score;
+};
+
+// Align both strands of a query against a target, hits[0] forward and
+// hits[1] reverse.  DNA pairs fill the two matrices together, in one pass
+// over the target's profile, which both strands share; other pairs, and
+// scores the profile cannot hold, are aligned one strand at a time by
+// comparing bytes.
+void alignBothStrands(const StrandQuery& q, const std::string& target,
+                      int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                      AlignWorkspace ws[2], StrandHit hits[2]) {
+    if(!q.encoded || detectAlphabet(target) != DNA_ALPHABET || !profileHolds(matchScore, mismatchScore)) {
+        for(int s = 0; s < 2; ++s) {
+            alignGeneral(q.strand[s], target, matchScore, mismatchScore, gapScore, mode,
+                         hits[s].align1, hits[s].align2, hits[s].score, ws[s]);
+        }
+        return;
+    }
+    int len1 = q.strand[0].size();
+    int len2 = target.size();
+    buildQueryProfile(target, alphabetCodes(DNA_ALPHABET), matchScore, mismatchScore, ws[0].profile);
+    prepareDP(len1, len2, gapScore, mode, ws[0]);
+    prepareDP(len1, len2, gapScore, mode, ws[1]);
+    int *score0 = ws[0].score.data(), *score1 = ws[1].score.data();
+    unsigned char *dir0 = ws[0].dir.data(), *dir1 = ws[1].dir.data();
+    const signed char *profile = ws[0].profile.data();
+    const int floorScore = floorScoreFor(mode);
+    
+    size_t rowCells = (size_t)len2 + 1;
+    for(int i = 1; i <= len1; ++i) {
+        const signed char *profile0 = profile + (size_t)symbolAt(q.codes[0].data(), i-1, 2) * len2;
+        const signed char *profile1 = profile + (size_t)symbolAt(q.codes[1].data(), i-1, 2) * len2;
+        int *row0 = score0 + i * rowCells, *row1 = score1 + i * rowCells;
+        unsigned char *rowDir0 = dir0 + i * rowCells, *rowDir1 = dir1 + i * rowCells;
+        for(int j = 1; j <= len2; ++j) {
+            rowDir0[j] = fillCell(row0 - rowCells, row0, j, profile0[j-1], gapScore, floorScore);
+            rowDir1[j] = fillCell(row1 - rowCells, row1, j, profile1[j-1], gapScore, floorScore);
+        }
+    }
+    for(int s = 0; s < 2; ++s) {
+        finishDP(q.strand[s], target, mode, hits[s].align1, hits[s].align2, hits[s].score, ws[s]);
+    }
+}
+
+// A PSSM column's scores against each residue of a sequence
+struct PssmRow {
+    const Pssm *pssm;
+    int column;
+    const char *seq;
+    int operator()(int j) const { return pssm->score(column, seq[j]); }
+};
+
+// Align a PSSM against a sequence; align1 is the profile's consensus and the
+// score is in PSSM units
+void profileAlign(const Pssm& pssm, const std::string& seq, AlignMode mode,
+                  std::string& align1, std::string& align2, int& maxScore,
+                  AlignWorkspace& ws) {
+    alignDP(pssm.consensus, seq, [&](int i) { return PssmRow{&pssm, i, seq.data()}; },
+            pssm.gapScore, mode, align1, align2, maxScore, ws);
+}
+
 // Compute GCG checksum for a sequence
 int gcgChecksum(const std::string &s) {
     long check = 0;
@@ -189,143 +894,1961 @@ int gcgChecksum(const std::string &s) {
 }
 
 // Determine sequence type (DNA or protein)
-char determineSequenceType(const std::string& align1, const std::string& align2) {
-    std::string allAligned = align1 + align2;
+char determineSequenceType(const std::vector<std::string>& rows) {
     bool maybeDNA = true;
-    for(char c : allAligned) {
-        // skip gaps
-        if(c == '.') continue;
-        char u = std::toupper(static_cast<unsigned char>(c));
-        if(u != 'A' && u != 'C' && u != 'G' && u != 'T' && u != 'U' && u != 'N') {
-            maybeDNA = false;
-            break;
+    for(const std::string& row : rows) {
+        for(char c : row) {
+            // skip gaps
+            if(c == '.') continue;
+            char u = std::toupper(static_cast<unsigned char>(c));
+            if(u != 'A' && u != 'C' && u != 'G' && u != 'T' && u != 'U' && u != 'N') {
+                maybeDNA = false;
+                break;
+            }
         }
+        if(!maybeDNA) break;
     }
     return maybeDNA ? 'N' : 'P';
 }
 
-// Print alignment in MSF format
-void printMSFAlignment(const std::string& name1, const std::string& name2,
-                     const std::string& align1, const std::string& align2,
-                     int maxScore) {
-    int alignLen = align1.size();
+// Write aligned rows in MSF format, '.' for gaps
+void writeMSFRows(std::ostream& out, const std::vector<std::string>& names,
+                  const std::vector<std::string>& rows) {
+    int alignLen = rows.empty() ? 0 : rows[0].size();
+    char line[256];
     
     // Compute checksums
-    int check1 = gcgChecksum(align1);
-    int check2 = gcgChecksum(align2);
-    int globalCheck = ((long)check1 + (long)check2) % 10000;
+    std::vector<int> checks;
+    long globalCheck = 0;
+    for(const std::string& row : rows) {
+        checks.push_back(gcgChecksum(row));
+        globalCheck += checks.back();
+    }
+    globalCheck %= 10000;
     
     // Determine sequence type
-    char typeChar = determineSequenceType(align1, align2);
-    
-    std::cout << "Alignment score: " << maxScore << "\n\n";
+    char typeChar = determineSequenceType(rows);
     
     // Output alignment in MSF (PileUp) format
-    std::cout << "PileUp\n\n";
-    std::printf("   MSF:   %d  Type: %c    Check:  %4d   ..\n\n", alignLen, typeChar, globalCheck);
-    std::printf(" Name: %s oo  Len:   %d  Check:  %4d  Weight:  10.0\n", name1.c_str(), alignLen, check1);
-    std::printf(" Name: %s oo  Len:   %d  Check:  %4d  Weight:  10.0\n\n", name2.c_str(), alignLen, check2);
-    std::cout << "//\n\n";
+    out << "PileUp\n\n";
+    std::snprintf(line, sizeof(line), "   MSF:   %d  Type: %c    Check:  %4ld   ..\n\n", alignLen, typeChar, globalCheck);
+    out << line;
+    for(size_t r = 0; r < rows.size(); ++r) {
+        std::snprintf(line, sizeof(line), " Name: %s oo  Len:   %d  Check:  %4d  Weight:  10.0\n",
+                      names[r].c_str(), alignLen, checks[r]);
+        out << line;
+    }
+    out << "\n//\n\n";
     
     // Print aligned sequences in blocks of 50 columns
     int colsPerLine = 50;
     for(int start = 0; start < alignLen; start += colsPerLine) {
         int end = (start + colsPerLine < alignLen) ? (start + colsPerLine) : alignLen;
-        // Sequence 1 line
-        std::printf("%-12s", name1.c_str());  // name left padded to 12 characters
-        // Print sequence with a space every 10 residues
-        int count = 0;
-        for(int k = start; k < end; ++k) {
-            std::cout << align1[k];
-            count++;
-            if(count % 10 == 0 && k < end - 1) {
-                std::cout << ' ';
-            }
-        }
-        std::cout << "\n";
-        // Sequence 2 line
-        std::printf("%-12s", name2.c_str());
-        count = 0;
-        for(int k = start; k < end; ++k) {
-            std::cout << align2[k];
-            count++;
-            if(count % 10 == 0 && k < end - 1) {
-                std::cout << ' ';
+        for(size_t r = 0; r < rows.size(); ++r) {
+            std::snprintf(line, sizeof(line), "%-12s", names[r].c_str());  // name left padded to 12 characters
+            out << line;
+            // Print sequence with a space every 10 residues
+            int count = 0;
+            for(int k = start; k < end; ++k) {
+                out << rows[r][k];
+                count++;
+                if(count % 10 == 0 && k < end - 1) {
+                    out << ' ';
+                }
             }
+            out << "\n";
         }
-        std::cout << "\n\n";
+        out << "\n";
     }
 }
 
-int main(int argc, char **argv) {
-    // Start timing the execution
-    auto startTime = std::chrono::high_resolution_clock::now();
-    
-    if(argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <seq1.fasta> <seq2.fasta>\n";
-        return 1;
-    }
-    std::string file1 = argv[1];
-    std::string file2 = argv[2];
+// Write a pairwise alignment in MSF format, preceded by its score and, for
+// a both-strand search, the strand of the first sequence
+void writeMSFAlignment(std::ostream& out,
+                       const std::string& name1, const std::string& name2,
+                       const std::string& align1, const std::string& align2,
+                       int maxScore, const char *strand = NULL) {
+    out << "Alignment score: " << maxScore << "\n";
+    if(strand) out << "Strand: " << strand << "\n";
+    out << "\n";
+    writeMSFRows(out, {name1, name2}, {align1, align2});
+}
+
+// Print alignment in MSF format
+void printMSFAlignment(const std::string& name1, const std::string& name2,
+                     const std::string& align1, const std::string& align2,
+                     int maxScore) {
+    writeMSFAlignment(std::cout, name1, name2, align1, align2, maxScore);
+}
+
+// Print execution time to stderr in the most appropriate unit
+void reportExecutionTime(std::chrono::high_resolution_clock::time_point startTime) {
+    auto endTime = std::chrono::high_resolution_clock::now();
     
-    // Read sequences from FASTA files
-    std::string name1, name2;
-    std::string seq1, seq2;
+    // Calculate durations in different units for more precise reporting
+    auto durationMicro = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+    auto durationNano = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
     
-    if(!readFastaFile(file1, name1, seq1) || !readFastaFile(file2, name2, seq2)) {
-        std::cerr << "Error: unable to open or parse input FASTA file(s).\n";
-        return 1;
+    // Output timing in the most appropriate unit
+    if (durationMicro < 10000) {  // Less than 10ms, show in microseconds
+        std::cerr << "CPU Execution time: " << durationMicro << " μs (" << durationNano << " ns)" << std::endl;
+    } else {
+        // For longer runtimes, show in milliseconds with microsecond precision
+        double durationMs = static_cast<double>(durationMicro) / 1000.0;
+        std::cerr << "CPU Execution time: " << std::fixed << std::setprecision(3) << durationMs << " ms" << std::endl;
     }
+}
+
+long long microsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Where the records of a manifest run go: stdout, or an indexed archive
+struct RecordSink {
+    std::string archivePath;
+    ArchiveWriter archive;
     
-    // If names are not provided in FASTA, use filenames instead
-    if(name1.empty()) {
-        name1 = extractBaseName(file1);
-    }
-    if(name2.empty()) {
-        name2 = extractBaseName(file2);
+    bool write(const std::string& family, const std::string& label, const std::string& msf) {
+        if(archivePath.empty()) {
+            std::cout << "Pair: " << label << "\n" << msf;
+            return true;
+        }
+        if(archive.append(family, label, msf)) return true;
+        std::cerr << "Error: unable to write to archive " << archivePath << "\n";
+        return false;
     }
     
-    // Strip any prefixes from sequence names
-    name1 = stripPrefix(name1);
-    name2 = stripPrefix(name2);
-    
-    // Convert sequences to uppercase
-    toUpperCase(seq1);
-    toUpperCase(seq2);
+    // The record of a pair pruned below the minimum score: its Pair: line
+    // alone, so shards, merges, scoring and resumed runs count it as done
+    bool writePruned(const std::string& family, const std::string& label) {
+        if(archivePath.empty()) {
+            std::cout << "Pair: " << label << "\n";
+            return true;
+        }
+        if(archive.appendPruned(family, label)) return true;
+        std::cerr << "Error: unable to write to archive " << archivePath << "\n";
+        return false;
+    }
+};
+
+// Number the sequences of the families in todo by content and plan which of
+// the pairs repeat an earlier one (see sequenceDedup.h).  Pairs of families
+// that cannot be read, or with an empty sequence, are left to fail as usual.
+void planManifestDedup(const PairManifest& manifest, const std::vector<size_t>& todo, DedupPlan& dedup) {
+    SequenceIds ids;
+    std::vector<std::vector<int>> familyIds(manifest.families.size());
+    std::vector<std::pair<int, int>> keys;
+    size_t sequences = 0;
+    for(size_t k : todo) {
+        const ManifestPair& pair = manifest.pairs[k];
+        std::vector<int>& fid = familyIds[pair.family];
+        if(fid.empty()) {
+            std::vector<std::string> seqs;
+            if(loadManifestFamily(manifest.families[pair.family], seqs)) {
+                for(std::string& seq : seqs) {
+                    toUpperCase(seq);
+                    fid.push_back(seq.empty() ? -1 : ids.id(seq));
+                }
+            } else {
+                fid.assign(manifest.families[pair.family].seqs.size(), -1);
+            }
+            sequences += fid.size();
+        }
+        keys.push_back(std::make_pair(fid[pair.seq1], fid[pair.seq2]));
+    }
+    dedup.plan(keys);
+    std::cerr << "Dedup: " << ids.count() << " distinct of " << sequences << " sequences, "
+              << dedup.saved() << " of " << todo.size() << " alignments saved\n";
+}
+
+// The record of a duplicate pair, from the result of the first pair with the
+// same sequences, under its own names; returns the shared score
+int shareDuplicate(const PairManifest& manifest, const std::vector<size_t>& todo, DedupPlan& dedup,
+                    size_t ordinal, std::string& msf, std::string& error) {
+    const PairResult& result = dedup.resultFor(ordinal);
+    const ManifestPair& pair = manifest.pairs[todo[ordinal]];
+    if(result.error.empty()) {
+        const ManifestFamily& fam = manifest.families[pair.family];
+        std::ostringstream out;
+        writeMSFAlignment(out, fam.seqs[pair.seq1].name, fam.seqs[pair.seq2].name,
+                          result.align1, result.align2, result.maxScore);
+        msf = out.str();
+    } else {
+        error = pairLabel(manifest, pair) + ": duplicate of " +
+                pairLabel(manifest, manifest.pairs[todo[dedup.firstOf(ordinal)]]) + ", which failed";
+    }
+    int maxScore = result.maxScore;
+    dedup.done(ordinal);
+    return maxScore;
+}
+
+// Pairs a run with a minimum score wrote a pruned record for, and the cells
+// it did not fill
+struct PruneStats {
+    long long pairs;
+    long long cells;
+};
+
+// Align the manifest pairs listed in todo one after another, each distinct
+// pair once if there is a dedup plan, and write the records of those scoring
+// at least minScore, and pruned records for the others.  Returns the number
+// of pairs that failed, or -1 if the run had to stop.
+int alignPairsSerial(const PairManifest& manifest, const std::vector<size_t>& todo, RecordSink& sink,
+                     DedupPlan *dedup, int minScore, PruneStats& pruned,
+                     int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    int loaded = -1;
+    std::vector<std::string> seqs;
+    AlignWorkspace ws;
+    ws.minScore = minScore;
+    int failures = 0;
+    for(size_t o = 0; o < todo.size(); ++o) {
+        const ManifestPair& pair = manifest.pairs[todo[o]];
+        const ManifestFamily& fam = manifest.families[pair.family];
+        if(dedup && dedup->isCopy(o)) {
+            std::string msf, error;
+            if(shareDuplicate(manifest, todo, *dedup, o, msf, error) < minScore && error.empty()) {
+                pruned.pairs++;
+                if(!sink.writePruned(fam.name, pairLabel(manifest, pair))) return -1;
+            } else if(!error.empty()) {
+                std::cerr << "Error: " << error << "\n";
+                failures++;
+            } else if(!sink.write(fam.name, pairLabel(manifest, pair), msf)) {
+                return -1;
+            }
+            continue;
+        }
+        if(pair.family != loaded) {
+            if(!loadManifestFamily(fam, seqs)) {
+                std::cerr << "Error: unable to read sequences from " << fam.tfaPath << "\n";
+                return -1;
+            }
+            for(std::string& seq : seqs) toUpperCase(seq);
+            loaded = pair.family;
+        }
+        const std::string& seq1 = seqs[pair.seq1];
+        const std::string& seq2 = seqs[pair.seq2];
+        if(seq1.empty() || seq2.empty()) {
+            std::cerr << "Error: " << pairLabel(manifest, pair) << ": one of the sequences is empty.\n";
+            failures++;
+            continue;
+        }
+        
+        std::string align1, align2;
+        int maxScore;
+        smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode,
+                      align1, align2, maxScore, ws);
+        if(dedup && dedup->hasCopies(o)) dedup->keep(o, PairResult{align1, align2, maxScore, ""});
+        if(maxScore < minScore) {
+            pruned.pairs++;
+            if(!sink.writePruned(fam.name, pairLabel(manifest, pair))) return -1;
+            continue;
+        }
+        
+        std::ostringstream msf;
+        writeMSFAlignment(msf, fam.seqs[pair.seq1].name, fam.seqs[pair.seq2].name,
+                          align1, align2, maxScore);
+        if(!sink.write(fam.name, pairLabel(manifest, pair), msf.str())) return -1;
+    }
+    pruned.cells = ws.prunedCells;
+    return failures;
+}
+
+// Score of one pair after the first phase of a two-phase run
+struct ScoredPair {
+    int score;
+    int endI, endJ;
+    bool failed;
+};
+
+// Align the manifest pairs listed in todo in two phases.  The first scores
+// every pair in linear memory and keeps its score and end cell; the second
+// aligns only the pairs scoring at least minScore, or the topK best of them
+// (ties to the earlier pair), with alignDeferred, and writes their records
+// in manifest order, with pruned records for the other pairs, for which no
+// direction matrix is built.
+// Returns the number of pairs that failed, or -1 if the run had to stop.
+int alignPairsTwoPhase(const PairManifest& manifest, const std::vector<size_t>& todo, RecordSink& sink,
+                       DedupPlan *dedup, int minScore, size_t topK, PruneStats& pruned,
+                       int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    int loaded = -1;
+    std::vector<std::string> seqs;
+    auto loadPair = [&](const ManifestPair& pair) {
+        if(pair.family != loaded) {
+            if(!loadManifestFamily(manifest.families[pair.family], seqs)) return false;
+            for(std::string& seq : seqs) toUpperCase(seq);
+            loaded = pair.family;
+        }
+        return true;
+    };
+    
+    // Phase one: scores and end cells
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ScoredPair> scored(todo.size());
+    AlignWorkspace ws;
+    ws.minScore = minScore;
+    int failures = 0;
+    size_t scoredPairs = 0;
+    long long cells = 0;
+    for(size_t o = 0; o < todo.size(); ++o) {
+        const ManifestPair& pair = manifest.pairs[todo[o]];
+        ScoredPair& sp = scored[o];
+        if(dedup && dedup->isCopy(o)) {
+            sp = scored[dedup->firstOf(o)];
+            if(sp.failed) {
+                std::cerr << "Error: " << pairLabel(manifest, pair) << ": duplicate of "
+                          << pairLabel(manifest, manifest.pairs[todo[dedup->firstOf(o)]]) << ", which failed\n";
+                failures++;
+            }
+            continue;
+        }
+        sp.failed = true;
+        if(!loadPair(pair)) {
+            std::cerr << "Error: unable to read sequences from " << manifest.families[pair.family].tfaPath << "\n";
+            return -1;
+        }
+        const std::string& seq1 = seqs[pair.seq1];
+        const std::string& seq2 = seqs[pair.seq2];
+        if(seq1.empty() || seq2.empty()) {
+            std::cerr << "Error: " << pairLabel(manifest, pair) << ": one of the sequences is empty.\n";
+            failures++;
+            continue;
+        }
+        scorePair(seq1, seq2, matchScore, mismatchScore, gapScore, mode, sp.score, ws);
+        sp.endI = ws.endI;
+        sp.endJ = ws.endJ;
+        sp.failed = false;
+        scoredPairs++;
+        cells += (long long)seq1.size() * seq2.size();
+    }
+    pruned.cells = ws.prunedCells;
+    long long scoreMicros = microsSince(start);
     
+    // Pick the pairs to align
+    std::vector<size_t> picked;
+    for(size_t o = 0; o < todo.size(); ++o) {
+        if(!scored[o].failed && scored[o].score >= minScore) picked.push_back(o);
+    }
+    if(topK > 0 && picked.size() > topK) {
+        std::stable_sort(picked.begin(), picked.end(),
+                         [&](size_t a, size_t b) { return scored[a].score > scored[b].score; });
+        picked.resize(topK);
+        std::sort(picked.begin(), picked.end());
+    }
+    
+    // Phase two: the picked pairs' alignments, a copy taking its first pair's
+    std::vector<bool> isPicked(todo.size(), false);
+    for(size_t o : picked) isPicked[o] = true;
+    std::map<size_t, PairResult> kept;
+    AlignWorkspace alignWs;
+    size_t alignedPairs = 0;
+    long long alignedCells = 0;
+    start = std::chrono::steady_clock::now();
+    for(size_t o = 0; o < todo.size(); ++o) {
+        const ManifestPair& pair = manifest.pairs[todo[o]];
+        const ManifestFamily& fam = manifest.families[pair.family];
+        if(scored[o].failed) continue;
+        if(!isPicked[o]) {
+            pruned.pairs++;
+            if(!sink.writePruned(fam.name, pairLabel(manifest, pair))) return -1;
+            continue;
+        }
+        size_t first = dedup ? dedup->firstOf(o) : o;
+        PairResult& result = kept[first];
+        if(first == o) {
+            if(!loadPair(pair)) {
+                std::cerr << "Error: unable to read sequences from " << fam.tfaPath << "\n";
+                return -1;
+            }
+            const ScoredPair& sp = scored[o];
+            alignedCells += alignDeferred(seqs[pair.seq1], seqs[pair.seq2], matchScore, mismatchScore, gapScore,
+                                          mode, sp.score, sp.endI, sp.endJ, result.align1, result.align2, alignWs);
+            result.maxScore = sp.score;
+            alignedPairs++;
+        }
+        std::ostringstream msf;
+        writeMSFAlignment(msf, fam.seqs[pair.seq1].name, fam.seqs[pair.seq2].name,
+                          result.align1, result.align2, result.maxScore);
+        if(!sink.write(fam.name, pairLabel(manifest, pair), msf.str())) return -1;
+        if(first == o && !(dedup && dedup->hasCopies(o))) kept.erase(o);
+    }
+    long long alignMicros = microsSince(start);
+    
+    std::cerr << std::fixed << std::setprecision(1);
+    std::cerr << "Two-phase: scored " << scoredPairs << " pairs in " << scoreMicros / 1000.0
+              << " ms over " << cells << " cells, aligned " << alignedPairs << " in " << alignMicros / 1000.0
+              << " ms over " << alignedCells << " cells";
+    if(picked.size() > alignedPairs) std::cerr << ", " << picked.size() - alignedPairs << " copies shared";
+    std::cerr << "\n";
+    return failures;
+}
+
+// Threads in each stage of the manifest pipeline
+struct PipelineConfig {
+    int readers;
+    int aligners;
+    int writers;
+    size_t memoryBudget;    // bytes the aligners' pairs may hold at once, 0 for no limit
+};
+
+// Where the pipeline and server put their worker threads
+struct PlacementConfig {
+    bool pin;           // pin each worker to a core, nodes taken in turn
+    bool replicas;      // give each NUMA node its own copy of the sequences
+};
+
+// Print where each worker of a stage will run
+void reportPlacement(const CpuTopology& topo, const char *stage, int first, int count) {
+    std::cerr << "  " << stage << ":";
+    for(int w = first; w < first + count; ++w) {
+        int cpu = placementCpu(topo, w);
+        std::cerr << " cpu " << cpu << "/node " << topo.nodeIds[cpuNodeOf(topo, cpu)]
+                  << (w + 1 < first + count ? "," : "\n");
+    }
+}
+
+// Pin the calling worker as planned; returns the index of its node.  Called
+// before the worker allocates anything, so its buffers land on that node.
+int placeWorker(const CpuTopology *topo, int worker) {
+    if(!topo) return 0;
+    int cpu = placementCpu(*topo, worker);
+    if(!pinCurrentThread(cpu)) {
+        std::cerr << "Warning: unable to pin worker " << worker << " to cpu " << cpu << "\n";
+    }
+    return cpuNodeOf(*topo, cpu);
+}
+
+// Upper-cased sequences of one family, shared read-only between threads
+typedef std::shared_ptr<const std::vector<std::string>> FamilySequences;
+
+// One NUMA node's replica of the families being aligned.  The first aligner
+// on the node to need a family copies it, so the copy is in the node's own
+// memory; only the last few families are kept.
+class NodeSequenceStore {
+public:
+    FamilySequences get(int family, const FamilySequences& primary) {
+        std::lock_guard<std::mutex> guard(lock);
+        for(const auto& entry : families) {
+            if(entry.first == family) return entry.second;
+        }
+        FamilySequences copy = std::make_shared<const std::vector<std::string>>(*primary);
+        families.push_back(std::make_pair(family, copy));
+        if(families.size() > 4) families.pop_front();
+        return copy;
+    }
+    
+private:
+    std::mutex lock;
+    std::deque<std::pair<int, FamilySequences>> families;
+};
+
+// One pair on its way through the pipeline.  Tasks are recycled through a
+// fixed ring, so their strings keep their capacity from pair to pair.
+struct PairTask {
+    size_t ordinal;          // position in the run, for writing in order
+    size_t pair;             // index into the manifest's pairs
+    FamilySequences family;  // with replicas, in place of seq1 and seq2
+    std::string seq1, seq2;
+    bool duplicate;          // takes the result of an earlier pair instead
+    std::string align1, align2;
+    int maxScore;
+    std::string msf;
+    std::string error;
+};
+
+// State shared by the pipeline's threads.  Readers take a free task, load and
+// upper-case the two sequences and queue it for the aligners; aligners run
+// the DP and queue it for the writers; writers format the MSF and put the
+// record out once every earlier one is out, then free the task.  Each queue
+// holds the whole ring, so the ring alone bounds the pairs in flight.  With
+// replicas, readers pass the family instead of copying the two sequences, and
+// aligners read them from their node's store.
+struct ManifestPipeline {
+    const PairManifest *manifest;
+    const std::vector<size_t> *todo;
+    RecordSink *sink;
+    int matchScore, mismatchScore, gapScore;
+    AlignMode mode;
+    PipelineConfig config;
+    const CpuTopology *topo;             // NULL unless pinning
+    std::vector<NodeSequenceStore> *stores;   // NULL unless replicating
+    MemoryBudget *budget;                // NULL unless admitting by memory
+    DedupPlan *dedup;                    // NULL unless deduplicating; under commitLock
+    int minScore;                        // records below it are written pruned
+    
+    std::vector<PairTask> tasks;
+    BoundedQueue<PairTask *> freeTasks, alignQueue, writeQueue;
+    std::atomic<size_t> nextOrdinal;
+    std::atomic<int> readersLeft, alignersLeft;
+    std::atomic<bool> stopped;           // a record could not be written
+    std::atomic<long long> busyMicros[3];
+    std::atomic<long long> admitMicros;  // aligners' time waiting for memory
+    std::atomic<int> spilledPairs;       // sent out of core to fit the budget
+    std::atomic<long long> prunedCells;
+    
+    std::mutex commitLock;
+    std::vector<PairTask *> window;      // finished tasks by ordinal, modulo the ring
+    size_t nextCommit;
+    int failures;
+    long long prunedPairs;
+    
+    ManifestPipeline(size_t ringSize) : tasks(ringSize), freeTasks(ringSize), alignQueue(ringSize),
+        writeQueue(ringSize), nextOrdinal(0), readersLeft(0), alignersLeft(0), stopped(false),
+        admitMicros(0), spilledPairs(0), prunedCells(0),
+        window(ringSize, NULL), nextCommit(0), failures(0), prunedPairs(0) {
+        for(std::atomic<long long>& b : busyMicros) b.store(0);
+        for(PairTask& t : tasks) freeTasks.push(&t);
+    }
+};
+
+void pipelineReader(ManifestPipeline *p, int worker) {
+    placeWorker(p->topo, worker);
+    const PairManifest& manifest = *p->manifest;
+    int loaded = -1;
+    FamilySequences family;
+    while(!p->stopped.load()) {
+        PairTask *task = p->freeTasks.pop();
+        size_t ordinal = p->nextOrdinal.fetch_add(1);
+        if(ordinal >= p->todo->size()) {
+            p->freeTasks.push(task);
+            break;
+        }
+        auto start = std::chrono::steady_clock::now();
+        task->ordinal = ordinal;
+        task->pair = (*p->todo)[ordinal];
+        task->duplicate = p->dedup && p->dedup->isCopy(ordinal);
+        task->error.clear();
+        const ManifestPair& pair = manifest.pairs[task->pair];
+        const ManifestFamily& fam = manifest.families[pair.family];
+        if(pair.family != loaded) {
+            std::vector<std::string> seqs;
+            family.reset();
+            if(loadManifestFamily(fam, seqs)) {
+                for(std::string& seq : seqs) toUpperCase(seq);
+                family = std::make_shared<const std::vector<std::string>>(std::move(seqs));
+            }
+            loaded = pair.family;
+        }
+        task->family.reset();
+        if(task->duplicate) {
+            // Nothing to load: the writer fills it in from the first pair
+        } else if(!family) {
+            task->error = "unable to read sequences from " + fam.tfaPath;
+        } else if((*family)[pair.seq1].empty() || (*family)[pair.seq2].empty()) {
+            task->error = pairLabel(manifest, pair) + ": one of the sequences is empty.";
+        } else if(p->stores) {
+            task->family = family;
+        } else {
+            task->seq1.assign((*family)[pair.seq1]);
+            task->seq2.assign((*family)[pair.seq2]);
+        }
+        p->busyMicros[0] += microsSince(start);
+        p->alignQueue.push(task);
+    }
+    if(--p->readersLeft == 0) {
+        for(int t = 0; t < p->config.aligners; ++t) p->alignQueue.push(NULL);
+    }
+}
+
+// Workspaces that grew past this are freed after their pair under a memory
+// budget, so an aligner does not keep a big pair's matrices outside it
+const size_t KEEP_WORKSPACE_BYTES = 4u << 20;
+
+// Align a pair once the memory budget admits it.  A pair whose working set
+// on its engine is more than the whole budget is aligned out of core, with
+// tiles small enough to fit, instead of running over it.  A pair out of core
+// that fails is reported, not realigned in memory past what it was charged.
+// Returns the microseconds spent waiting for admission.
+long long alignAdmitted(ManifestPipeline *p, PairTask *task, const std::string& seq1, const std::string& seq2,
+                   AlignWorkspace& ws) {
+    if(pruneBeforeDP(seq1, seq2, p->matchScore, p->mismatchScore, p->gapScore,
+                     task->align1, task->align2, task->maxScore, ws)) {
+        return 0;
+    }
+    SequenceAlphabet alphabet = pairAlphabet(seq1, seq2);
+    size_t tileBytes;
+    TunedEngine engine = chooseEngine(alphabet, seq1.size(), seq2.size(), p->matchScore, p->mismatchScore,
+                                      tileBytes);
+    size_t bytes = pairWorkingSet(alphabet, engine, tileBytes, seq1.size(), seq2.size());
+    bool outOfCore = engine == OUT_OF_CORE_ENGINE;
+    if(!outOfCore && bytes > p->budget->capacity()) {
+        outOfCore = true;
+        tileBytes = std::min(SPILL_TILE_BYTES, p->budget->capacity() / 2);
+        bytes = pairWorkingSet(alphabet, OUT_OF_CORE_ENGINE, tileBytes, seq1.size(), seq2.size());
+        p->spilledPairs++;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    size_t charged = p->budget->acquire(bytes);
+    long long waited = microsSince(start);
+    std::string error;
+    if(!outOfCore) {
+        smithWaterman(seq1, seq2, p->matchScore, p->mismatchScore, p->gapScore, p->mode,
+                      task->align1, task->align2, task->maxScore, ws);
+    } else if(!alignOutOfCore(seq1, seq2, p->matchScore, p->mismatchScore, p->gapScore, p->mode,
+                              spillDirectory(), tileBytes, task->align1, task->align2, task->maxScore,
+                              ws.endI, ws.endJ, error)) {
+        task->error = pairLabel(*p->manifest, p->manifest->pairs[task->pair]) + ": " + error;
+    }
+    if(bytes > KEEP_WORKSPACE_BYTES) ws.releaseBuffers();
+    p->budget->release(charged);
+    return waited;
+}
+
+void pipelineAligner(ManifestPipeline *p, int worker) {
+    int node = placeWorker(p->topo, worker);
+    AlignWorkspace ws;
+    ws.minScore = p->minScore;
+    while(PairTask *task = p->alignQueue.pop()) {
+        auto start = std::chrono::steady_clock::now();
+        long long waited = 0;
+        if(task->error.empty() && !task->duplicate) {
+            const std::string *seq1 = &task->seq1, *seq2 = &task->seq2;
+            FamilySequences local;
+            if(task->family) {
+                const ManifestPair& pair = p->manifest->pairs[task->pair];
+                local = (*p->stores)[node].get(pair.family, task->family);
+                task->family.reset();
+                seq1 = &(*local)[pair.seq1];
+                seq2 = &(*local)[pair.seq2];
+            }
+            if(p->budget) {
+                waited = alignAdmitted(p, task, *seq1, *seq2, ws);
+            } else {
+                smithWaterman(*seq1, *seq2, p->matchScore, p->mismatchScore, p->gapScore, p->mode,
+                              task->align1, task->align2, task->maxScore, ws);
+            }
+        }
+        p->busyMicros[1] += microsSince(start) - waited;
+        p->admitMicros += waited;
+        p->writeQueue.push(task);
+    }
+    p->prunedCells += ws.prunedCells;
+    if(--p->alignersLeft == 0) {
+        for(int t = 0; t < p->config.writers; ++t) p->writeQueue.push(NULL);
+    }
+}
+
+void pipelineWriter(ManifestPipeline *p, int worker) {
+    placeWorker(p->topo, worker);
+    const PairManifest& manifest = *p->manifest;
+    std::ostringstream msf;
+    while(PairTask *task = p->writeQueue.pop()) {
+        auto start = std::chrono::steady_clock::now();
+        const ManifestPair& pair = manifest.pairs[task->pair];
+        const ManifestFamily& fam = manifest.families[pair.family];
+        if(task->error.empty() && !task->duplicate && task->maxScore >= p->minScore) {
+            msf.str("");
+            writeMSFAlignment(msf, fam.seqs[pair.seq1].name, fam.seqs[pair.seq2].name,
+                              task->align1, task->align2, task->maxScore);
+            task->msf = msf.str();
+        }
+        
+        // Put out this record and any later ones it was holding up
+        std::lock_guard<std::mutex> guard(p->commitLock);
+        size_t ring = p->window.size();
+        p->window[task->ordinal % ring] = task;
+        while(PairTask *next = p->window[p->nextCommit % ring]) {
+            if(next->ordinal != p->nextCommit) break;
+            const ManifestPair& np = manifest.pairs[next->pair];
+            if(next->duplicate) {
+                next->maxScore = shareDuplicate(manifest, *p->todo, *p->dedup, next->ordinal, next->msf, next->error);
+            } else if(p->dedup && p->dedup->hasCopies(next->ordinal)) {
+                p->dedup->keep(next->ordinal, PairResult{next->align1, next->align2, next->maxScore, next->error});
+            }
+            if(!next->error.empty()) {
+                std::cerr << "Error: " << next->error << "\n";
+                p->failures++;
+            } else if(next->maxScore < p->minScore) {
+                p->prunedPairs++;
+                if(!p->stopped.load() &&
+                   !p->sink->writePruned(manifest.families[np.family].name, pairLabel(manifest, np))) {
+                    p->stopped.store(true);
+                }
+            } else if(!p->stopped.load() &&
+                      !p->sink->write(manifest.families[np.family].name, pairLabel(manifest, np), next->msf)) {
+                p->stopped.store(true);
+            }
+            p->window[p->nextCommit % ring] = NULL;
+            p->nextCommit++;
+            p->freeTasks.push(next);
+        }
+        p->busyMicros[2] += microsSince(start);
+    }
+}
+
+// Align the manifest pairs listed in todo on a three-stage pipeline of
+// reader, aligner and writer threads.  The records come out in the same order
+// as alignPairsSerial writes them.  Returns the number of pairs that failed,
+// or -1 if the run had to stop.
+int alignPairsPipeline(const PairManifest& manifest, const std::vector<size_t>& todo, RecordSink& sink,
+                       DedupPlan *dedup, int minScore, PruneStats& pruned,
+                       const PipelineConfig& config, const PlacementConfig& placement, int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    size_t ringSize = 4 * config.aligners + config.readers + config.writers;
+    ManifestPipeline p(ringSize);
+    p.manifest = &manifest;
+    p.todo = &todo;
+    p.sink = &sink;
+    p.dedup = dedup;
+    p.minScore = minScore;
+    p.matchScore = matchScore;
+    p.mismatchScore = mismatchScore;
+    p.gapScore = gapScore;
+    p.mode = mode;
+    p.config = config;
+    p.readersLeft = config.readers;
+    p.alignersLeft = config.aligners;
+    
+    // Aligners are placed first, so they are the ones spread over the nodes
+    CpuTopology topo;
+    std::vector<NodeSequenceStore> stores;
+    p.topo = NULL;
+    p.stores = NULL;
+    std::unique_ptr<MemoryBudget> budget;
+    p.budget = NULL;
+    if(config.memoryBudget) {
+        budget.reset(new MemoryBudget(config.memoryBudget));
+        p.budget = budget.get();
+    }
+    if(placement.pin) {
+        topo = readCpuTopology();
+        p.topo = &topo;
+        std::cerr << "Placement: " << topo.nodeIds.size() << " NUMA node"
+                  << (topo.nodeIds.size() == 1 ? "" : "s");
+        if(placement.replicas && topo.nodeIds.size() > 1) {
+            stores = std::vector<NodeSequenceStore>(topo.nodeIds.size());
+            p.stores = &stores;
+            std::cerr << ", a sequence replica per node";
+        } else if(placement.replicas) {
+            std::cerr << ", no replicas needed";
+        }
+        std::cerr << "\n";
+        reportPlacement(topo, "aligners", 0, config.aligners);
+        reportPlacement(topo, "readers", config.aligners, config.readers);
+        reportPlacement(topo, "writers", config.aligners + config.readers, config.writers);
+    }
+    
+    std::vector<std::thread> threads;
+    int worker = 0;
+    for(int t = 0; t < config.aligners; ++t) threads.emplace_back(pipelineAligner, &p, worker++);
+    for(int t = 0; t < config.readers; ++t) threads.emplace_back(pipelineReader, &p, worker++);
+    for(int t = 0; t < config.writers; ++t) threads.emplace_back(pipelineWriter, &p, worker++);
+    for(std::thread& t : threads) t.join();
+    
+    // Per-stage time and queue occupancy: the stage with the full queue in
+    // front of it, or the most busy time per thread, is the bottleneck
+    std::cerr << std::fixed << std::setprecision(1);
+    std::cerr << "Pipeline: " << config.readers << " readers, " << config.aligners << " aligners, "
+              << config.writers << " writers, " << ringSize << " buffers\n";
+    std::cerr << "  read:  busy " << p.busyMicros[0] / 1000.0 << " ms, waited "
+              << p.freeTasks.emptyWaitCount() << " times for a free buffer\n";
+    std::cerr << "  align: busy " << p.busyMicros[1] / 1000.0 << " ms, queue "
+              << p.alignQueue.meanOccupancy() << " of " << ringSize << " on average, waited "
+              << p.alignQueue.emptyWaitCount() << " times for input\n";
+    if(p.budget) {
+        std::cerr << "  admit: budget " << p.budget->capacity() / 1048576.0 << " MB, peak "
+                  << p.budget->peakBytes() / 1048576.0 << " MB, waited " << p.budget->waitCount()
+                  << " times for " << p.admitMicros / 1000.0 << " ms, " << p.spilledPairs
+                  << " pairs out of core\n";
+    }
+    std::cerr << "  write: busy " << p.busyMicros[2] / 1000.0 << " ms, queue "
+              << p.writeQueue.meanOccupancy() << " of " << ringSize << " on average, waited "
+              << p.writeQueue.emptyWaitCount() << " times for input\n";
+    pruned.pairs = p.prunedPairs;
+    pruned.cells = p.prunedCells;
+    return p.stopped.load() ? -1 : p.failures;
+}
+
+// Align every pair listed in a manifest written by splitPairs.  Each family's
+// .tfa file is read once; each pair's MSF record is preceded by a
+// "Pair: <label>" line so bali_score -m can find it.  The records go to
+// stdout, or to an indexed archive (see pairArchive.h) if archivePath is set.
+// With a pipeline configuration, reading, aligning and writing run on
+// separate threads.  With dedup, each distinct pair of sequences is aligned
+// once and its record written under every pair of names it appears as.
+// Pairs scoring below minScore get a pruned record (see pairArchive.h), and
+// are given up on as soon as a bound shows they cannot reach it.  A two-phase run scores every pair
+// before aligning any, and aligns only those above minScore, or the topK
+// best.
+int alignManifest(const std::string& path, const std::string& archivePath, bool resume,
+                  int shard, int nShards, const PipelineConfig *pipeline, const PlacementConfig& placement,
+                  bool dedup, int minScore, bool twoPhase, size_t topK,
+                  int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    PairManifest manifest;
+    std::string error;
+    if(!readManifest(path, manifest, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    
+    // Align every pair, or just this node's shard of them
+    std::vector<size_t> selected = shardPairs(manifest, shard, nShards);
+    if(nShards > 1) {
+        long long cost = 0, total = 0;
+        for(size_t k : selected) cost += pairCost(manifest, manifest.pairs[k]);
+        for(const ManifestPair& pair : manifest.pairs) total += pairCost(manifest, pair);
+        std::cerr << "Shard " << shard << "/" << nShards << ": " << selected.size() << " of "
+                  << manifest.pairs.size() << " pairs, " << std::fixed << std::setprecision(1)
+                  << (total ? 100.0 * cost / total : 0.0) << "% of the estimated cost\n";
+    }
+    
+    // On resume, skip the pairs the archive already holds
+    RecordSink sink;
+    sink.archivePath = archivePath;
+    std::set<std::string> done;
+    if(resume) {
+        std::vector<ArchiveEntry> entries;
+        if(!sink.archive.resume(archivePath, entries)) {
+            std::cerr << "Error: unable to resume archive " << archivePath << "\n";
+            return 1;
+        }
+        size_t prunedDone = 0;
+        for(const ArchiveEntry& e : entries) {
+            done.insert(e.label);
+            prunedDone += e.pruned();
+        }
+        std::cerr << "Resuming " << archivePath << ": " << done.size() << " pairs already done";
+        if(prunedDone) std::cerr << ", " << prunedDone << " of them pruned";
+        std::cerr << "\n";
+    } else if(!archivePath.empty() && !sink.archive.open(archivePath)) {
+        std::cerr << "Error: unable to create archive " << archivePath << "\n";
+        return 1;
+    }
+    std::vector<size_t> todo;
+    for(size_t k : selected) {
+        if(!done.count(pairLabel(manifest, manifest.pairs[k]))) todo.push_back(k);
+    }
+    if(selected.size() - todo.size() < done.size()) {
+        std::cerr << "Warning: " << done.size() - (selected.size() - todo.size()) << " pairs in "
+                  << archivePath << " are not in this run's manifest or shard\n";
+    }
+    
+    DedupPlan plan;
+    if(dedup) planManifestDedup(manifest, todo, plan);
+    DedupPlan *shared = dedup ? &plan : NULL;
+    PruneStats pruned = { 0, 0 };
+    int failures;
+    if(twoPhase) {
+        failures = alignPairsTwoPhase(manifest, todo, sink, shared, minScore, topK, pruned,
+                                      matchScore, mismatchScore, gapScore, mode);
+    } else if(pipeline) {
+        failures = alignPairsPipeline(manifest, todo, sink, shared, minScore, pruned, *pipeline,
+                                      placement, matchScore, mismatchScore, gapScore, mode);
+    } else {
+        failures = alignPairsSerial(manifest, todo, sink, shared, minScore, pruned,
+                                    matchScore, mismatchScore, gapScore, mode);
+    }
+    if(minScore > INT_MIN) {
+        long long cells = 0;
+        for(size_t k : todo) cells += pairCost(manifest, manifest.pairs[k]) - 1;
+        std::cerr << "Min score " << minScore << ": " << pruned.pairs << " of " << todo.size()
+                  << " pairs below it, " << pruned.cells << " of " << cells << " cells skipped ("
+                  << std::fixed << std::setprecision(1) << (cells ? 100.0 * pruned.cells / cells : 0.0)
+                  << "%)\n";
+    }
+    if(!sink.archive.close()) {
+        std::cerr << "Error: unable to write to archive " << archivePath << "\n";
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
+
+// One request to the alignment server, from the connection that sent it
+struct ServerJob {
+    std::vector<std::string> request;
+    std::vector<std::string> response;
+    bool done;
+};
+
+// State shared by the server's threads.  Connection threads queue jobs; the
+// dispatcher takes everything queued as one batch and runs it on the worker
+// pool, whose threads each keep a warm workspace.
+struct AlignServer {
+    int matchScore, mismatchScore, gapScore;
+    AlignMode mode;
+    int listenFd;
+    
+    std::mutex lock;
+    std::condition_variable queued;      // jobs were queued, or stopping
+    std::condition_variable finished;    // a batch finished
+    std::deque<ServerJob *> pending;
+    bool stopping;
+    std::set<int> connections;
+    std::condition_variable closed;      // a connection closed
+    
+    // the batch being run
+    std::condition_variable batchReady;
+    std::vector<ServerJob *> batch;
+    size_t nextJob, jobsLeft;
+    unsigned long generation;
+    
+    long served, batches;
+    size_t largestBatch;
+};
+
+// Run one request: align or score two FASTA sequences
+void runServerJob(AlignServer& server, ServerJob& job, AlignWorkspace& ws) {
+    const std::vector<std::string>& req = job.request;
+    if(req.size() != 5 || (req[0] != "ALIGN" && req[0] != "SCORE")) {
+        job.response = {"ERR", "malformed request"};
+        return;
+    }
+    std::string name1, name2, seq1, seq2;
+    std::istringstream fasta1(req[2]), fasta2(req[4]);
+    readFasta(fasta1, name1, seq1);
+    readFasta(fasta2, name2, seq2);
+    name1 = sequenceName(name1, req[1]);
+    name2 = sequenceName(name2, req[3]);
+    toUpperCase(seq1);
+    toUpperCase(seq2);
     if(seq1.empty() || seq2.empty()) {
-        std::cerr << "Error: one of the sequences is empty.\n";
+        job.response = {"ERR", "one of the sequences is empty"};
+        return;
+    }
+    
+    std::string align1, align2;
+    int maxScore;
+    smithWaterman(seq1, seq2, server.matchScore, server.mismatchScore, server.gapScore, server.mode,
+                  align1, align2, maxScore, ws);
+    job.response = {"OK", std::to_string(maxScore)};
+    if(req[0] == "ALIGN") {
+        std::ostringstream msf;
+        writeMSFAlignment(msf, name1, name2, align1, align2, maxScore);
+        job.response.push_back(msf.str());
+    }
+}
+
+// Worker: run jobs from each batch until the batch is used up
+void serverWorker(AlignServer *server, const CpuTopology *topo, int worker) {
+    placeWorker(topo, worker);
+    AlignWorkspace ws;
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> guard(server->lock);
+    while(true) {
+        server->batchReady.wait(guard, [&] {
+            return server->generation != seen || (server->stopping && server->pending.empty());
+        });
+        if(server->generation == seen) return;
+        seen = server->generation;
+        while(server->nextJob < server->batch.size()) {
+            ServerJob *job = server->batch[server->nextJob++];
+            guard.unlock();
+            runServerJob(*server, *job, ws);
+            guard.lock();
+            if(--server->jobsLeft == 0) server->finished.notify_all();
+        }
+    }
+}
+
+// Dispatcher: hand everything queued to the workers as one batch
+void serverDispatcher(AlignServer *server) {
+    std::unique_lock<std::mutex> guard(server->lock);
+    while(true) {
+        server->queued.wait(guard, [&] { return !server->pending.empty() || server->stopping; });
+        if(server->pending.empty()) break;
+        server->batch.assign(server->pending.begin(), server->pending.end());
+        server->pending.clear();
+        server->nextJob = 0;
+        server->jobsLeft = server->batch.size();
+        server->generation++;
+        server->batchReady.notify_all();
+        server->finished.wait(guard, [&] { return server->jobsLeft == 0; });
+        
+        for(ServerJob *job : server->batch) job->done = true;
+        server->served += server->batch.size();
+        server->batches++;
+        server->largestBatch = std::max(server->largestBatch, server->batch.size());
+        server->finished.notify_all();
+    }
+    server->batchReady.notify_all();
+}
+
+// Connection: queue each request and send back its response
+void serveConnection(AlignServer *server, int fd) {
+    std::vector<std::string> request;
+    while(readFrame(fd, request)) {
+        if(request.size() == 1 && request[0] == "STOP") {
+            std::lock_guard<std::mutex> guard(server->lock);
+            server->stopping = true;
+            shutdown(server->listenFd, SHUT_RDWR);
+            server->queued.notify_all();
+            writeFrame(fd, {"OK"});
+            break;
+        }
+        ServerJob job;
+        job.request.swap(request);
+        job.done = false;
+        {
+            std::unique_lock<std::mutex> guard(server->lock);
+            if(server->stopping) {
+                guard.unlock();
+                writeFrame(fd, {"ERR", "server is stopping"});
+                break;
+            }
+            server->pending.push_back(&job);
+            server->queued.notify_one();
+            server->finished.wait(guard, [&] { return job.done; });
+        }
+        if(!writeFrame(fd, job.response)) break;
+    }
+    std::lock_guard<std::mutex> guard(server->lock);
+    close(fd);
+    server->connections.erase(fd);
+    server->closed.notify_all();
+}
+
+// Serve alignments on a Unix domain socket until a client sends STOP; see
+// alignProtocol.h for the messages
+int serveAlignments(const std::string& socketPath, int nThreads, bool pin,
+                    int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path " << socketPath << " is too long\n";
+        return 1;
+    }
+    std::strcpy(addr.sun_path, socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if(fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        std::cerr << "Error: unable to listen on " << socketPath << ": " << std::strerror(errno) << "\n";
+        if(fd >= 0) close(fd);
         return 1;
     }
+    // a client that goes away must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+    
+    AlignServer server;
+    server.matchScore = matchScore;
+    server.mismatchScore = mismatchScore;
+    server.gapScore = gapScore;
+    server.mode = mode;
+    server.listenFd = fd;
+    server.stopping = false;
+    server.nextJob = server.jobsLeft = 0;
+    server.generation = 0;
+    server.served = server.batches = 0;
+    server.largestBatch = 0;
+    
+    std::cerr << "Serving alignments on " << socketPath << " with " << nThreads << " threads\n";
+    CpuTopology topo;
+    if(pin) {
+        topo = readCpuTopology();
+        std::cerr << "Placement: " << topo.nodeIds.size() << " NUMA node"
+                  << (topo.nodeIds.size() == 1 ? "" : "s") << "\n";
+        reportPlacement(topo, "workers", 0, nThreads);
+    }
+    std::vector<std::thread> workers;
+    for(int t = 0; t < nThreads; ++t) workers.emplace_back(serverWorker, &server, pin ? &topo : NULL, t);
+    std::thread dispatcher(serverDispatcher, &server);
+    
+    while(true) {
+        int conn = accept(fd, NULL, NULL);
+        if(conn >= 0) {
+            std::lock_guard<std::mutex> guard(server.lock);
+            server.connections.insert(conn);
+            std::thread(serveConnection, &server, conn).detach();
+            continue;
+        }
+        if(errno == EINTR || errno == ECONNABORTED) continue;
+        std::lock_guard<std::mutex> guard(server.lock);
+        if(!server.stopping) std::cerr << "Error: accept failed: " << std::strerror(errno) << "\n";
+        server.stopping = true;
+        server.queued.notify_all();
+        break;
+    }
+    dispatcher.join();
+    for(std::thread& t : workers) t.join();
+    
+    // wait for the connections still open to see the end of their requests
+    {
+        std::unique_lock<std::mutex> guard(server.lock);
+        for(int conn : server.connections) shutdown(conn, SHUT_RD);
+        server.closed.wait(guard, [&] { return server.connections.empty(); });
+    }
+    close(fd);
+    unlink(socketPath.c_str());
+    std::cerr << "Served " << server.served << " requests in " << server.batches
+              << " batches (largest " << server.largestBatch << ")\n";
+    return 0;
+}
+
+// Read every sequence of a multi-FASTA file
+bool readMultiFasta(std::istream& fin, std::vector<std::string>& names, std::vector<std::string>& seqs) {
+    std::string line;
+    while(std::getline(fin, line)) {
+        if(line.size() > 0 && line[0] == '>') {
+            size_t pos = 1;
+            while(pos < line.size() && !isspace(static_cast<unsigned char>(line[pos]))) pos++;
+            names.push_back(line.substr(1, pos - 1));
+            seqs.push_back("");
+            continue;
+        }
+        if(seqs.empty()) continue;
+        for(char c : line) {
+            if(!isspace(static_cast<unsigned char>(c))) seqs.back().push_back(c);
+        }
+    }
+    return !seqs.empty();
+}
+
+// Align the listed pairs of seqs in parallel on nThreads threads, each
+// reusing its DP matrices; returns their scores in list order
+std::vector<int> scorePairList(const std::vector<std::string>& seqs, const std::vector<std::pair<int, int>>& pairs,
+                               int nThreads, int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    std::vector<int> scores(pairs.size(), 0);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        AlignWorkspace ws;
+        std::string align1, align2;
+        for(size_t k = next++; k < pairs.size(); k = next++) {
+            smithWaterman(seqs[pairs[k].first], seqs[pairs[k].second], matchScore, mismatchScore, gapScore,
+                          mode, align1, align2, scores[k], ws);
+        }
+    };
+    std::vector<std::thread> threads;
+    for(int t = 0; t < nThreads; ++t) threads.push_back(std::thread(worker));
+    for(std::thread& t : threads) t.join();
+    return scores;
+}
+
+// Align all pairs of a family in parallel and return their scores as a full
+// n x n matrix (the diagonal left 0).  Pairs of the same two sequence
+// contents are aligned once (see sequenceDedup.h); saved counts them.
+std::vector<int> scoreAllPairs(const std::vector<std::string>& seqs, int nThreads,
+                               int matchScore, int mismatchScore, int gapScore, AlignMode mode,
+                               size_t& saved) {
+    int n = seqs.size();
+    SequenceIds ids;
+    std::vector<int> id(n);
+    for(int i = 0; i < n; ++i) id[i] = ids.id(seqs[i]);
+    std::vector<std::pair<int, int>> pairs, keys;
+    for(int i = 0; i < n; ++i) {
+        for(int j = i + 1; j < n; ++j) {
+            pairs.push_back(std::make_pair(i, j));
+            keys.push_back(std::make_pair(id[i], id[j]));
+        }
+    }
+    std::vector<size_t> first = firstOfPairs(keys);
+    std::vector<std::pair<int, int>> distinct;
+    for(size_t k = 0; k < pairs.size(); ++k) {
+        if(first[k] == k) distinct.push_back(pairs[k]);
+    }
+    saved = pairs.size() - distinct.size();
+    
+    std::vector<int> scores((size_t)n * n, 0);
+    std::vector<int> distinctScores = scorePairList(seqs, distinct, nThreads, matchScore, mismatchScore,
+                                                    gapScore, mode);
+    for(size_t d = 0; d < distinct.size(); ++d) {
+        int i = distinct[d].first, j = distinct[d].second;
+        scores[i * n + j] = scores[j * n + i] = distinctScores[d];
+    }
+    for(size_t k = 0; k < pairs.size(); ++k) {
+        const std::pair<int, int>& from = pairs[first[k]];
+        int i = pairs[k].first, j = pairs[k].second;
+        scores[i * n + j] = scores[j * n + i] = scores[from.first * n + from.second];
+    }
+    return scores;
+}
+
+// Read a family's sequences, upper-cased, naming unnamed ones by position;
+// false, with the reason printed, if it cannot be read or one is empty
+bool loadFamily(const std::string& path, std::vector<std::string>& names, std::vector<std::string>& seqs) {
+    std::ifstream fin(path);
+    if(!fin.is_open() || !readMultiFasta(fin, names, seqs)) {
+        std::cerr << "Error: unable to open or parse " << path << "\n";
+        return false;
+    }
+    for(size_t i = 0; i < seqs.size(); ++i) {
+        toUpperCase(seqs[i]);
+        if(names[i].empty()) names[i] = "seq" + std::to_string(i + 1);
+        if(seqs[i].empty()) {
+            std::cerr << "Error: sequence " << names[i] << " in " << path << " is empty.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Build a progressive multiple alignment of one family: all-pairs scores,
+// a UPGMA guide tree over them, then profile merges along the tree
+int alignFamily(const std::string& path, int nThreads,
+                int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    std::vector<std::string> names, seqs;
+    if(!loadFamily(path, names, seqs)) return 1;
+    int n = seqs.size();
+
+    nThreads = std::min(nThreads, std::max(1, n * (n - 1) / 2));
+    auto start = std::chrono::steady_clock::now();
+    size_t saved;
+    std::vector<int> scores = scoreAllPairs(seqs, nThreads, matchScore, mismatchScore, gapScore, mode, saved);
+    long long scoreMicros = microsSince(start);
+
+    // Distance: the share of the best possible score (the shorter sequence
+    // against itself) that the pair does not reach
+    std::vector<double> dist((size_t)n * n, 0.0);
+    for(int i = 0; i < n; ++i) {
+        for(int j = i + 1; j < n; ++j) {
+            double self = (double)matchScore * std::min(seqs[i].size(), seqs[j].size());
+            double d = 1.0 - scores[i * n + j] / self;
+            dist[i * n + j] = dist[j * n + i] = std::min(1.0, std::max(0.0, d));
+        }
+    }
+
+    std::vector<Profile> profiles(n);
+    for(int i = 0; i < n; ++i) {
+        profiles[i].members.push_back(i);
+        profiles[i].rows.push_back(seqs[i]);
+    }
+    for(const GuideMerge& m : upgmaGuideTree(dist, n)) {
+        profiles[m.into] = alignProfiles(profiles[m.into], profiles[m.from],
+                                         matchScore, mismatchScore, gapScore);
+        profiles[m.from] = Profile();
+    }
+
+    // Rows back in input order, with MSF gaps
+    const Profile& msa = profiles[0];
+    std::vector<std::string> rows(n);
+    for(size_t r = 0; r < msa.members.size(); ++r) {
+        rows[msa.members[r]] = msa.rows[r];
+        std::replace(rows[msa.members[r]].begin(), rows[msa.members[r]].end(), '-', '.');
+    }
+    writeMSFRows(std::cout, names, rows);
+    std::cerr << n << " sequences, " << n * (n - 1) / 2 - saved << " pairs scored (" << saved
+              << " duplicates saved) in "
+              << std::fixed << std::setprecision(3) << scoreMicros / 1000.0 << " ms with "
+              << nThreads << " threads; " << msa.length() << " columns\n";
+    return 0;
+}
+
+// Score every pair of a family into the score table at tablePath (see
+// scoreTable.h).  Pairs the table already holds a score for, by content and
+// with the same scoring, are not aligned again, so adding k sequences to a
+// family of N aligns about kN pairs; the merged table replaces the old one.
+int allVsAll(const std::string& path, const std::string& tablePath, int nThreads,
+             int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    ScoreTable table;
+    std::vector<std::string> seqs;
+    if(!loadFamily(path, table.names, seqs)) return 1;
+    size_t n = seqs.size();
+    table.scoring = std::string(alignModeName(mode)) + " " + std::to_string(matchScore) + " " +
+                    std::to_string(mismatchScore) + " " + std::to_string(gapScore);
+    for(const std::string& seq : seqs) table.keys.push_back(sequenceKey(seq));
+    
+    // Scores of the previous run, by the contents of their pair
+    ScoreTable old;
+    int badLine;
+    std::map<std::pair<SequenceKey, SequenceKey>, int> known;
+    if(readScoreTable(tablePath, old, badLine)) {
+        if(old.scoring != table.scoring) {
+            std::cerr << "Warning: " << tablePath << " was scored as " << old.scoring << ", not "
+                      << table.scoring << "; rescoring every pair\n";
+            old = ScoreTable();
+        }
+        for(size_t i = 0; i < old.size(); ++i) {
+            for(size_t j = i + 1; j < old.size(); ++j) {
+                known[std::make_pair(old.keys[i], old.keys[j])] = old.score(i, j);
+            }
+        }
+    } else if(badLine) {
+        std::cerr << "Error: unable to read score table " << tablePath << " (line " << badLine << ")\n";
+        return 1;
+    }
+    std::set<SequenceKey> oldKeys(old.keys.begin(), old.keys.end());
+    size_t fresh = 0;
+    for(const SequenceKey& key : table.keys) fresh += !oldKeys.count(key);
+    
+    // Align the pairs not in the table, each distinct pair of contents once
+    table.scores.assign(n * n, 0);
+    SequenceIds ids;
+    std::vector<int> id(n);
+    for(size_t i = 0; i < n; ++i) id[i] = ids.id(seqs[i]);
+    std::vector<std::pair<int, int>> missing, keys;
+    size_t reused = 0;
+    for(size_t i = 0; i < n; ++i) {
+        for(size_t j = i + 1; j < n; ++j) {
+            auto it = known.find(std::make_pair(table.keys[i], table.keys[j]));
+            if(it != known.end()) {
+                table.scores[i * n + j] = it->second;
+                reused++;
+            } else {
+                missing.push_back(std::make_pair(i, j));
+                keys.push_back(std::make_pair(id[i], id[j]));
+            }
+        }
+    }
+    std::vector<size_t> first = firstOfPairs(keys);
+    std::vector<std::pair<int, int>> distinct;
+    for(size_t k = 0; k < missing.size(); ++k) {
+        if(first[k] == k) distinct.push_back(missing[k]);
+    }
+    nThreads = std::min(nThreads, std::max(1, (int)distinct.size()));
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> distinctScores = scorePairList(seqs, distinct, nThreads, matchScore, mismatchScore,
+                                                    gapScore, mode);
+    long long scoreMicros = microsSince(start);
+    for(size_t d = 0, k = 0; k < missing.size(); ++k) {
+        const std::pair<int, int>& from = missing[first[k]];
+        if(first[k] == k) {
+            table.scores[from.first * n + from.second] = distinctScores[d++];
+        } else {
+            table.scores[missing[k].first * n + missing[k].second] = table.scores[from.first * n + from.second];
+        }
+    }
+    
+    if(!writeScoreTable(tablePath, table)) {
+        std::cerr << "Error: unable to write score table " << tablePath << "\n";
+        return 1;
+    }
+    std::cerr << n << " sequences, " << fresh << " new or changed; " << distinct.size() << " of "
+              << n * (n - 1) / 2 << " pairs aligned in " << std::fixed << std::setprecision(3)
+              << scoreMicros / 1000.0 << " ms with " << nThreads << " threads (" << reused
+              << " from the table, " << missing.size() - distinct.size() << " duplicates)\n";
+    return 0;
+}
+
+// Align each candidate sequence against the PSSM of an MSF, printing one
+// MSF per candidate with the profile consensus as its first row
+int alignToProfile(const std::string& msfPath, const std::vector<std::string>& fastaPaths,
+                   int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    Pssm pssm;
+    if(!loadMsfPssm(msfPath, matchScore, mismatchScore, gapScore, pssm)) {
+        std::cerr << "Error: unable to build a profile from " << msfPath << "\n";
+        return 1;
+    }
+    std::string profileName = extractBaseName(msfPath);
+    std::cerr << "Profile " << profileName << ": " << pssm.sequences << " sequences, "
+              << pssm.consensus.size() << " of " << pssm.alignedColumns << " columns\n";
+    
+    AlignWorkspace ws;
+    int failures = 0;
+    for(const std::string& path : fastaPaths) {
+        std::string name, seq;
+        if(!readFastaFile(path, name, seq) || seq.empty()) {
+            std::cerr << "Error: unable to read a sequence from " << path << "\n";
+            failures++;
+            continue;
+        }
+        toUpperCase(seq);
+        std::string align1, align2;
+        int maxScore;
+        profileAlign(pssm, seq, mode, align1, align2, maxScore, ws);
+        writeMSFAlignment(std::cout, profileName, sequenceName(name, path), align1, align2, maxScore);
+    }
+    return failures ? 1 : 0;
+}
+
+// Search a nucleotide query on both strands of each target, printing the
+// better strand's alignment for each; ties go to the forward strand
+int searchBothStrands(const std::string& queryPath, const std::vector<std::string>& targetPaths,
+                      int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    std::string queryName, query;
+    if(!readFastaFile(queryPath, queryName, query) || query.empty()) {
+        std::cerr << "Error: unable to read a sequence from " << queryPath << "\n";
+        return 1;
+    }
+    toUpperCase(query);
+    if(!isNucleotide(query)) {
+        std::cerr << "Error: --both-strands needs a nucleotide query\n";
+        return 1;
+    }
+    queryName = sequenceName(queryName, queryPath);
+    StrandQuery q = makeStrandQuery(query);
+    
+    AlignWorkspace ws[2];
+    StrandHit hits[2];
+    int failures = 0;
+    for(const std::string& path : targetPaths) {
+        std::string name, target;
+        if(!readFastaFile(path, name, target) || target.empty()) {
+            std::cerr << "Error: unable to read a sequence from " << path << "\n";
+            failures++;
+            continue;
+        }
+        toUpperCase(target);
+        alignBothStrands(q, target, matchScore, mismatchScore, gapScore, mode, ws, hits);
+        int best = hits[1].score > hits[0].score ? 1 : 0;
+        writeMSFAlignment(std::cout, queryName, sequenceName(name, path), hits[best].align1,
+                          hits[best].align2, hits[best].score, best ? "reverse" : "forward");
+    }
+    return failures ? 1 : 0;
+}
+
+// What an engine reports for one pair, compared field by field with the
+// reference
+struct EngineResult {
+    int score;
+    int endI, endJ;
+    std::string align1, align2;
+    std::string msf;
+};
+
+struct CheckEngine {
+    std::string name;
+    std::function<void(const std::string&, const std::string&, AlignMode, EngineResult&)> run;
+};
+
+void finishEngineResult(EngineResult& r) {
+    std::ostringstream msf;
+    writeMSFAlignment(msf, "seq1", "seq2", r.align1, r.align2, r.score);
+    r.msf = msf.str();
+}
+
+// The reference: the byte-compare kernel with fresh matrices
+void referenceEngine(const std::string& seq1, const std::string& seq2, AlignMode mode,
+                     int matchScore, int mismatchScore, int gapScore, EngineResult& r) {
+    AlignWorkspace ws;
+    alignGeneral(seq1, seq2, matchScore, mismatchScore, gapScore, mode,
+                  r.align1, r.align2, r.score, ws);
+    r.endI = ws.endI;
+    r.endJ = ws.endJ;
+    finishEngineResult(r);
+}
+
+// Every engine that must agree with the reference
+std::vector<CheckEngine> checkEngines(int matchScore, int mismatchScore, int gapScore) {
+    std::vector<CheckEngine> engines;
+    // smithWaterman() as every mode calls it: the kernel for the pair's alphabet
+    engines.push_back(CheckEngine{"alphabet", [=](const std::string& seq1, const std::string& seq2,
+                                                  AlignMode mode, EngineResult& r) {
+        AlignWorkspace ws;
+        smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode,
+                      r.align1, r.align2, r.score, ws);
+        r.endI = ws.endI;
+        r.endJ = ws.endJ;
+        finishEngineResult(r);
+    }});
+    // matrices kept from earlier, often larger, pairs, as the server and
+    // pipeline workers keep them
+    std::shared_ptr<AlignWorkspace> kept = std::make_shared<AlignWorkspace>();
+    engines.push_back(CheckEngine{"workspace", [=](const std::string& seq1, const std::string& seq2,
+                                                   AlignMode mode, EngineResult& r) {
+        smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode,
+                      r.align1, r.align2, r.score, *kept);
+        r.endI = kept->endI;
+        r.endJ = kept->endJ;
+        finishEngineResult(r);
+    }});
+    // the profile kernel on a one-sequence PSSM, scores back in pairwise units
+    engines.push_back(CheckEngine{"profile", [=](const std::string& seq1, const std::string& seq2,
+                                                 AlignMode mode, EngineResult& r) {
+        AlignWorkspace ws;
+        Pssm pssm = buildPssm({seq1}, matchScore, mismatchScore, gapScore);
+        profileAlign(pssm, seq2, mode, r.align1, r.align2, r.score, ws);
+        r.score = r.score % PSSM_SCALE == 0 ? r.score / PSSM_SCALE : INT_MIN;
+        r.endI = ws.endI;
+        r.endJ = ws.endJ;
+        finishEngineResult(r);
+    }});
+    // linear-space scores and spilled directions, in tiles of a few rows so
+    // that the traceback crosses tile boundaries
+    engines.push_back(CheckEngine{"out-of-core", [=](const std::string& seq1, const std::string& seq2,
+                                                     AlignMode mode, EngineResult& r) {
+        const char *tmp = std::getenv("TMPDIR");
+        std::string error;
+        if(!alignOutOfCore(seq1, seq2, matchScore, mismatchScore, gapScore, mode, tmp ? tmp : "/tmp",
+                           16, r.align1, r.align2, r.score, r.endI, r.endJ, error)) {
+            r.score = INT_MIN;
+        }
+        finishEngineResult(r);
+    }});
+    // score-only pass, then the alignment redone from its score and end cell
+    engines.push_back(CheckEngine{"deferred", [=](const std::string& seq1, const std::string& seq2,
+                                                  AlignMode mode, EngineResult& r) {
+        AlignWorkspace ws;
+        scorePair(seq1, seq2, matchScore, mismatchScore, gapScore, mode, r.score, ws);
+        alignDeferred(seq1, seq2, matchScore, mismatchScore, gapScore, mode, r.score, ws.endI, ws.endJ,
+                      r.align1, r.align2, ws);
+        r.endI = ws.endI;
+        r.endJ = ws.endJ;
+        finishEngineResult(r);
+    }});
+    // both strands in one pass: the forward strand of seq1, and the reverse
+    // strand of its reverse complement, which is seq1 again (sequences with
+    // U, which do not survive the round trip, are only checked forward)
+    engines.push_back(CheckEngine{"strand+", [=](const std::string& seq1, const std::string& seq2,
+                                                 AlignMode mode, EngineResult& r) {
+        AlignWorkspace ws[2];
+        StrandHit hits[2];
+        alignBothStrands(makeStrandQuery(seq1), seq2, matchScore, mismatchScore, gapScore, mode, ws, hits);
+        r.align1 = hits[0].align1;
+        r.align2 = hits[0].align2;
+        r.score = hits[0].score;
+        r.endI = ws[0].endI;
+        r.endJ = ws[0].endJ;
+        finishEngineResult(r);
+    }});
+    engines.push_back(CheckEngine{"strand-", [=](const std::string& seq1, const std::string& seq2,
+                                                 AlignMode mode, EngineResult& r) {
+        AlignWorkspace ws[2];
+        StrandHit hits[2];
+        std::string rc = reverseComplement(seq1);
+        int s = reverseComplement(rc) == seq1 ? 1 : 0;
+        alignBothStrands(makeStrandQuery(s ? rc : seq1), seq2, matchScore, mismatchScore, gapScore,
+                         mode, ws, hits);
+        r.align1 = hits[s].align1;
+        r.align2 = hits[s].align2;
+        r.score = hits[s].score;
+        r.endI = ws[s].endI;
+        r.endJ = ws[s].endJ;
+        finishEngineResult(r);
+    }});
+    return engines;
+}
+
+// First difference between an engine's result and the reference, or ""
+std::string compareEngineResults(const EngineResult& ref, const EngineResult& got) {
+    std::ostringstream why;
+    if(got.score != ref.score) {
+        why << "score " << got.score << ", expected " << ref.score;
+    } else if(got.endI != ref.endI || got.endJ != ref.endJ) {
+        why << "end cell (" << got.endI << "," << got.endJ << "), expected ("
+            << ref.endI << "," << ref.endJ << ")";
+    } else if(got.align1 != ref.align1 || got.align2 != ref.align2) {
+        why << "alignment " << got.align1 << "/" << got.align2 << ", expected "
+            << ref.align1 << "/" << ref.align2;
+    } else if(got.msf != ref.msf) {
+        why << "MSF bytes differ";
+    }
+    return why.str();
+}
+
+// Run every engine on the corpus and on nPairs generated pairs; failures are
+// shrunk, reported and added to the corpus
+int checkEnginesAgree(long nPairs, unsigned seed, int maxLength, const std::string& corpusPath,
+                      int matchScore, int mismatchScore, int gapScore) {
+    std::vector<CheckEngine> engines = checkEngines(matchScore, mismatchScore, gapScore);
+    std::vector<CheckCase> corpus;
+    if(!corpusPath.empty()) corpus = readCheckCorpus(corpusPath);
+    std::set<std::string> known;
+    for(const CheckCase& c : corpus) known.insert(c.mode + " " + c.seq1 + " " + c.seq2);
+    std::mt19937 rng(seed);
+    std::vector<long> failures(engines.size(), 0);
+
+    auto disagreement = [&](const CheckEngine& engine, const CheckCase& c) {
+        AlignMode mode;
+        if(!parseAlignMode(c.mode, mode) || c.seq1.empty() || c.seq2.empty()) return std::string();
+        EngineResult ref, got;
+        referenceEngine(c.seq1, c.seq2, mode, matchScore, mismatchScore, gapScore, ref);
+        engine.run(c.seq1, c.seq2, mode, got);
+        return compareEngineResults(ref, got);
+    };
+
+    long total = corpus.size() + nPairs;
+    for(long k = 0; k < total; ++k) {
+        bool fromCorpus = k < (long)corpus.size();
+        CheckCase c = fromCorpus ? corpus[k] : generateCheckCase(rng, k - corpus.size(), maxLength);
+        for(size_t e = 0; e < engines.size(); ++e) {
+            if(disagreement(engines[e], c).empty()) continue;
+            failures[e]++;
+            CheckCase small = shrinkCheckCase(c, [&](const CheckCase& t) {
+                return !disagreement(engines[e], t).empty();
+            });
+            std::cerr << "FAIL " << engines[e].name << " " << small.mode << " " << small.seq1 << " "
+                      << small.seq2 << ": " << disagreement(engines[e], small) << "\n";
+            if(!corpusPath.empty() && known.insert(small.mode + " " + small.seq1 + " " + small.seq2).second) {
+                appendCheckCorpus(corpusPath, small);
+            }
+        }
+    }
+
+    long failed = 0;
+    for(size_t e = 0; e < engines.size(); ++e) {
+        std::cerr << engines[e].name << ": " << total << " pairs, " << failures[e] << " disagreements\n";
+        failed += failures[e];
+    }
+    std::cerr << corpus.size() << " corpus and " << nPairs << " generated pairs (seed " << seed << ")\n";
+    return failed ? 1 : 0;
+}
+
+// Best time of one engine on a pair, in microseconds, over at least three
+// runs and about 50 ms; -1 if it failed
+long long timeEngine(const std::function<bool()>& run) {
+    long long best = -1, total = 0;
+    for(int runs = 0; runs < 3 || (total < 50000 && runs < 1000); ++runs) {
+        auto start = std::chrono::steady_clock::now();
+        if(!run()) return -1;
+        long long micros = microsSince(start);
+        total += micros;
+        if(best < 0 || micros < best) best = micros;
+    }
+    return best;
+}
+
+// Time every engine on homologous pairs of growing length for each
+// alphabet, and write the fastest per alphabet and size as a tuning profile
+int autotune(const std::string& profilePath, int maxLength,
+             int matchScore, int mismatchScore, int gapScore, AlignMode mode) {
+    const char *letters[] = { "ACGT", "ACDEFGHIKLMNPQRSTVWY", "ACDEFGHIKLMNPQRSTVWYJO" };
+    const size_t tileSizes[] = { 1u << 20, 16u << 20, 64u << 20 };
+    const char *tmp = std::getenv("TMPDIR");
+    std::string spillDir = tmp ? tmp : "/tmp";
+    std::vector<int> lengths;
+    for(int len = 100; len <= maxLength; len *= 3) lengths.push_back(len);
+
+    activeTuning = NULL;
+    std::mt19937 rng(1);
+    TuningProfile profile;
+    for(int a = DNA_ALPHABET; a <= GENERAL_ALPHABET; ++a) {
+        for(size_t k = 0; k < lengths.size(); ++k) {
+            std::string seq1 = randomResidues(rng, letters[a], lengths[k]);
+            std::string seq2 = mutateResidues(rng, seq1, letters[a], 0.3);
+            std::vector<TuningRule> candidates;
+            if(a != GENERAL_ALPHABET) candidates.push_back(TuningRule{(SequenceAlphabet)a, 0, ALPHABET_ENGINE, 0});
+            candidates.push_back(TuningRule{(SequenceAlphabet)a, 0, GENERAL_ENGINE, 0});
+            for(size_t tile : tileSizes) candidates.push_back(TuningRule{(SequenceAlphabet)a, 0, OUT_OF_CORE_ENGINE, tile});
+
+            AlignWorkspace ws;
+            std::string align1, align2, error;
+            int score, endI, endJ;
+            // the engine an untuned run would use is listed first, and is
+            // only replaced by one at least 5% faster, so noise does not
+            // decide
+            TuningRule best = candidates[0];
+            long long bestMicros = -1, defaultMicros = -1;
+            std::cerr << std::left << std::setw(8) << ALPHABET_NAMES[a] << std::right << std::setw(6)
+                      << seq1.size() << " x " << std::left << std::setw(6) << seq2.size() << std::right;
+            for(const TuningRule& c : candidates) {
+                long long micros = timeEngine([&]() {
+                    if(c.engine == GENERAL_ENGINE) {
+                        alignGeneral(seq1, seq2, matchScore, mismatchScore, gapScore, mode, align1, align2, score, ws);
+                    } else if(c.engine == ALPHABET_ENGINE) {
+                        smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode, align1, align2, score, ws);
+                    } else {
+                        return alignOutOfCore(seq1, seq2, matchScore, mismatchScore, gapScore, mode, spillDir,
+                                              c.tileBytes, align1, align2, score, endI, endJ, error);
+                    }
+                    return true;
+                });
+                std::cerr << "  " << ENGINE_NAMES[c.engine];
+                if(c.engine == OUT_OF_CORE_ENGINE) std::cerr << "/" << (c.tileBytes >> 20) << "MB";
+                if(micros < 0) {
+                    std::cerr << " failed";
+                    continue;
+                }
+                std::cerr << " " << micros << " μs";
+                if(&c == &candidates[0]) defaultMicros = micros;
+                if(bestMicros < 0 || (micros < bestMicros &&
+                                      (defaultMicros < 0 || micros < defaultMicros * 0.95))) {
+                    bestMicros = micros;
+                    best = c;
+                }
+            }
+            std::cerr << "  -> " << ENGINE_NAMES[best.engine] << "\n";
+
+            // each length stands for the sizes up to the geometric midpoint
+            // with the next; a run of rules with the same choice becomes one
+            best.maxCells = k + 1 < lengths.size() ? (long long)lengths[k] * lengths[k + 1] : LLONG_MAX;
+            TuningRule *last = profile.rules.empty() ? NULL : &profile.rules.back();
+            if(last && last->alphabet == best.alphabet && last->engine == best.engine &&
+               last->tileBytes == best.tileBytes) {
+                last->maxCells = best.maxCells;
+            } else {
+                profile.rules.push_back(best);
+            }
+        }
+    }
+
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    std::string comment = std::string("tuned on ") + host + ", " +
+                          std::to_string(std::thread::hardware_concurrency()) + " CPUs, lengths up to " +
+                          std::to_string(lengths.empty() ? 0 : lengths.back());
+    if(!writeTuningProfile(profilePath, profile, comment)) {
+        std::cerr << "Error: unable to write " << profilePath << "\n";
+        return 1;
+    }
+    std::cerr << "Wrote " << profile.rules.size() << " rules to " << profilePath << "\n";
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Start timing the execution
+    auto startTime = std::chrono::high_resolution_clock::now();
     
     // Scoring scheme
     int matchScore = 2;
     int mismatchScore = -1;
     int gapScore = -1;
     
-    // Perform Smith-Waterman alignment
-    std::string align1, align2;
-    int maxScore;
+    // Alignment mode, taken from anywhere on the command line
+    AlignMode mode = LOCAL_ALIGNMENT;
+    for(int a = 1; a + 1 < argc; ++a) {
+        if(std::string(argv[a]) != "-a") continue;
+        if(!parseAlignMode(argv[a + 1], mode)) {
+            std::cerr << "Error: unknown alignment mode " << argv[a + 1]
+                      << " (local, global, semiglobal or glocal)\n";
+            return 1;
+        }
+        for(int b = a; b + 2 <= argc; ++b) argv[b] = argv[b + 2];
+        argc -= 2;
+        break;
+    }
     
-    smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, 
-                  align1, align2, maxScore);
+    // Tuning profile, likewise
+    TuningProfile tuning;
+    for(int a = 1; a + 1 < argc; ++a) {
+        if(std::string(argv[a]) != "--tuning") continue;
+        int badLine;
+        if(!readTuningProfile(argv[a + 1], tuning, badLine)) {
+            std::cerr << "Error: unable to read tuning profile " << argv[a + 1];
+            if(badLine) std::cerr << " (line " << badLine << ")";
+            std::cerr << "\n";
+            return 1;
+        }
+        activeTuning = &tuning;
+        for(int b = a; b + 2 <= argc; ++b) argv[b] = argv[b + 2];
+        argc -= 2;
+        break;
+    }
     
-    // Calculate and output execution time with microsecond precision
-    auto endTime = std::chrono::high_resolution_clock::now();
+    if(argc >= 3 && std::string(argv[1]) == "-m") {
+        std::string archivePath;
+        int shard = 0, nShards = 1;
+        bool resume = false, dedup = false, twoPhase = false;
+        int minScore = INT_MIN;
+        size_t topK = 0;
+        PipelineConfig pipeline;
+        pipeline.memoryBudget = 0;
+        bool usePipeline = false;
+        PlacementConfig placement = { false, false };
+        for(int a = 3; a < argc; a += 2) {
+            std::string opt = argv[a];
+            if(opt == "--dedup") {
+                dedup = true;
+                a--;
+            } else if(opt == "--two-phase") {
+                twoPhase = true;
+                a--;
+            } else if(opt == "--resume") {
+                resume = true;
+                a--;
+            } else if(opt == "--pin") {
+                placement.pin = true;
+                a--;
+            } else if(opt == "--numa") {
+                placement.pin = true;
+                placement.replicas = true;
+                a--;
+            } else if(a + 1 < argc && opt == "-o") {
+                archivePath = argv[a + 1];
+            } else if(a + 1 < argc && opt == "--shard" && parseShard(argv[a + 1], shard, nShards)) {
+                continue;
+            } else if(a + 1 < argc && opt == "--pipeline" &&
+                      std::sscanf(argv[a + 1], "%d:%d:%d", &pipeline.readers, &pipeline.aligners,
+                                  &pipeline.writers) == 3 &&
+                      pipeline.readers > 0 && pipeline.aligners > 0 && pipeline.writers > 0) {
+                usePipeline = true;
+            } else if(a + 1 < argc && opt == "--min-score" && parseScore(argv[a + 1], minScore)) {
+                continue;
+            } else if(a + 1 < argc && opt == "--top" && std::atol(argv[a + 1]) > 0) {
+                topK = std::atol(argv[a + 1]);
+            } else if(a + 1 < argc && opt == "--memory" && std::atol(argv[a + 1]) > 0) {
+                pipeline.memoryBudget = (size_t)std::atol(argv[a + 1]) << 20;
+            } else {
+                std::cerr << "Usage: " << argv[0] << " -m <manifest> [-o <archive> [--resume]] [--shard i/N] [--dedup] [--min-score s]"
+                          << " [--two-phase [--top K]]"
+                          << " [--pipeline readers:aligners:writers [--pin|--numa] [--memory MB]]\n";
+                return 1;
+            }
+        }
+        if(placement.pin && !usePipeline) {
+            std::cerr << "Error: --pin and --numa place the threads of --pipeline\n";
+            return 1;
+        }
+        if(topK && !twoPhase) {
+            std::cerr << "Error: --top picks the pairs of --two-phase\n";
+            return 1;
+        }
+        if(twoPhase && usePipeline) {
+            std::cerr << "Error: --two-phase runs without --pipeline\n";
+            return 1;
+        }
+        if(pipeline.memoryBudget && !usePipeline) {
+            std::cerr << "Error: --memory admits the pairs of --pipeline\n";
+            return 1;
+        }
+        if(resume && archivePath.empty()) {
+            std::cerr << "Error: --resume needs an archive (-o <archive>)\n";
+            return 1;
+        }
+        int status = alignManifest(argv[2], archivePath, resume, shard, nShards,
+                                   usePipeline ? &pipeline : NULL, placement, dedup, minScore,
+                                   twoPhase, topK, matchScore, mismatchScore, gapScore, mode);
+        reportExecutionTime(startTime);
+        return status;
+    }
     
-    // Calculate durations in different units for more precise reporting
-    auto durationMicro = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
-    auto durationNano = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+    if(argc >= 3 && std::string(argv[1]) == "-s") {
+        int nThreads = std::max(1u, std::thread::hardware_concurrency());
+        bool pin = false;
+        for(int a = 3; a < argc; ++a) {
+            std::string opt = argv[a];
+            if(opt == "--pin") {
+                pin = true;
+            } else if(a + 1 < argc && opt == "-t" && std::atoi(argv[a + 1]) > 0) {
+                nThreads = std::atoi(argv[++a]);
+            } else {
+                std::cerr << "Usage: " << argv[0] << " -s <socket> [-t threads] [--pin]\n";
+                return 1;
+            }
+        }
+        return serveAlignments(argv[2], nThreads, pin, matchScore, mismatchScore, gapScore, mode);
+    }
     
-    // Output timing in the most appropriate unit
-    if (durationMicro < 10000) {  // Less than 10ms, show in microseconds
-        std::cerr << "CPU Execution time: " << durationMicro << " μs (" << durationNano << " ns)" << std::endl;
+    if(argc >= 3 && std::string(argv[1]) == "-M") {
+        int nThreads = std::max(1u, std::thread::hardware_concurrency());
+        if(argc == 5 && std::string(argv[3]) == "-t" && std::atoi(argv[4]) > 0) {
+            nThreads = std::atoi(argv[4]);
+        } else if(argc != 3) {
+            std::cerr << "Usage: " << argv[0] << " -M <family.tfa> [-t threads]\n";
+            return 1;
+        }
+        int status = alignFamily(argv[2], nThreads, matchScore, mismatchScore, gapScore, mode);
+        reportExecutionTime(startTime);
+        return status;
+    }
+    
+    if(argc >= 4 && std::string(argv[1]) == "--all-vs-all") {
+        int nThreads = std::max(1u, std::thread::hardware_concurrency());
+        if(argc == 6 && std::string(argv[4]) == "-t" && std::atoi(argv[5]) > 0) {
+            nThreads = std::atoi(argv[5]);
+        } else if(argc != 4) {
+            std::cerr << "Usage: " << argv[0] << " --all-vs-all <family.tfa> <scores.tab> [-t threads]\n";
+            return 1;
+        }
+        int status = allVsAll(argv[2], argv[3], nThreads, matchScore, mismatchScore, gapScore, mode);
+        reportExecutionTime(startTime);
+        return status;
+    }
+    
+    if(argc >= 3 && std::string(argv[1]) == "--autotune") {
+        int maxLength = 10000;
+        if(argc == 5 && std::string(argv[3]) == "-l" && std::atoi(argv[4]) >= 100) {
+            maxLength = std::atoi(argv[4]);
+        } else if(argc != 3) {
+            std::cerr << "Usage: " << argv[0] << " --autotune <profile> [-l max length]\n";
+            return 1;
+        }
+        return autotune(argv[2], maxLength, matchScore, mismatchScore, gapScore, mode);
+    }
+    
+    if(argc >= 2 && std::string(argv[1]) == "--check") {
+        long nPairs = 10000;
+        unsigned seed = 1;
+        int maxLength = 40;
+        std::string corpusPath;
+        for(int a = 2; a < argc; a += 2) {
+            std::string opt = argv[a];
+            if(a + 1 < argc && opt == "-n" && std::atol(argv[a + 1]) >= 0) {
+                nPairs = std::atol(argv[a + 1]);
+            } else if(a + 1 < argc && opt == "--seed") {
+                seed = std::strtoul(argv[a + 1], NULL, 10);
+            } else if(a + 1 < argc && opt == "-l" && std::atoi(argv[a + 1]) > 0) {
+                maxLength = std::atoi(argv[a + 1]);
+            } else if(a + 1 < argc && opt == "-c") {
+                corpusPath = argv[a + 1];
+            } else {
+                std::cerr << "Usage: " << argv[0] << " --check [-n pairs] [--seed s] [-l max length] [-c corpus]\n";
+                return 1;
+            }
+        }
+        return checkEnginesAgree(nPairs, seed, maxLength, corpusPath, matchScore, mismatchScore, gapScore);
+    }
+    
+    if(argc >= 2 && std::string(argv[1]) == "--both-strands") {
+        if(argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " --both-strands <query.fasta> <target.fasta> [<target.fasta> ...]\n";
+            return 1;
+        }
+        int status = searchBothStrands(argv[2], std::vector<std::string>(argv + 3, argv + argc),
+                                       matchScore, mismatchScore, gapScore, mode);
+        reportExecutionTime(startTime);
+        return status;
+    }
+    
+    if(argc >= 3 && std::string(argv[1]) == "-p") {
+        if(argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " -p <profile.msf> <seq.fasta> [<seq.fasta> ...]\n";
+            return 1;
+        }
+        int status = alignToProfile(argv[2], std::vector<std::string>(argv + 3, argv + argc),
+                                    matchScore, mismatchScore, gapScore, mode);
+        reportExecutionTime(startTime);
+        return status;
+    }
+    
+    // Two-file mode, optionally with the direction matrix spilled to disk
+    std::string spillDir;
+    if(argc == 5 && std::string(argv[1]) == "--out-of-core") {
+        spillDir = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    
+    if(argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " [-a mode] [--out-of-core <dir>] <seq1.fasta> <seq2.fasta>\n";
+        std::cerr << "       " << argv[0] << " [-a mode] -m <manifest> [-o <archive> [--resume]] [--shard i/N] [--dedup] [--min-score s]"
+                  << " [--two-phase [--top K]]"
+                  << " [--pipeline readers:aligners:writers [--pin|--numa] [--memory MB]]\n";
+        std::cerr << "       " << argv[0] << " [-a mode] -s <socket> [-t threads] [--pin]\n";
+        std::cerr << "       " << argv[0] << " [-a mode] -M <family.tfa> [-t threads]\n";
+        std::cerr << "       " << argv[0] << " [-a mode] --all-vs-all <family.tfa> <scores.tab> [-t threads]\n";
+        std::cerr << "       " << argv[0] << " [-a mode] -p <profile.msf> <seq.fasta> [<seq.fasta> ...]\n";
+        std::cerr << "       " << argv[0] << " [-a mode] --both-strands <query.fasta> <target.fasta> [<target.fasta> ...]\n";
+        std::cerr << "       " << argv[0] << " --check [-n pairs] [--seed s] [-l max length] [-c corpus]\n";
+        std::cerr << "       " << argv[0] << " [-a mode] --autotune <profile> [-l max length]\n";
+        std::cerr << "       mode: local (default), global, semiglobal or glocal\n";
+        std::cerr << "       --tuning <profile> before any mode sends each pair to its tuned engine\n";
+        return 1;
+    }
+    std::string file1 = argv[1];
+    std::string file2 = argv[2];
+    
+    // Read sequences from FASTA files
+    std::string name1, name2;
+    std::string seq1, seq2;
+    
+    if(!readFastaFile(file1, name1, seq1) || !readFastaFile(file2, name2, seq2)) {
+        std::cerr << "Error: unable to open or parse input FASTA file(s).\n";
+        return 1;
+    }
+    
+    // If names are not provided in FASTA, use filenames instead, and strip
+    // any prefixes from sequence names
+    name1 = sequenceName(name1, file1);
+    name2 = sequenceName(name2, file2);
+    
+    // Convert sequences to uppercase
+    toUpperCase(seq1);
+    toUpperCase(seq2);
+    
+    if(seq1.empty() || seq2.empty()) {
+        std::cerr << "Error: one of the sequences is empty.\n";
+        return 1;
+    }
+    
+    // Perform Smith-Waterman alignment
+    std::string align1, align2;
+    int maxScore;
+    
+    if(spillDir.empty()) {
+        smithWaterman(seq1, seq2, matchScore, mismatchScore, gapScore, mode,
+                      align1, align2, maxScore);
     } else {
-        // For longer runtimes, show in milliseconds with microsecond precision
-        double durationMs = static_cast<double>(durationMicro) / 1000.0;
-        std::cerr << "CPU Execution time: " << std::fixed << std::setprecision(3) << durationMs << " ms" << std::endl;
+        int endI, endJ;
+        std::string error;
+        if(!alignOutOfCore(seq1, seq2, matchScore, mismatchScore, gapScore, mode, spillDir,
+                           SPILL_TILE_BYTES, align1, align2, maxScore, endI, endJ, error)) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
     }
     
+    // Calculate and output execution time with microsecond precision
+    reportExecutionTime(startTime);
+    
     // Print alignment in MSF format
     printMSFAlignment(name1, name2, align1, align2, maxScore);
     
@@ -0,0 +1,108 @@
+// directionSpill.h - Direction matrix kept on disk for out-of-core alignment
+//
+// A genome-scale pair has too many cells for the score and direction
+// matrices to fit in memory.  The out-of-core engine keeps only two rows of
+// scores, and writes the directions, packed 2 bits a cell, to a temporary
+// file that is memory-mapped one tile of rows at a time: the fill walks the
+// tiles forwards, the traceback backwards, so only one tile is mapped at
+// once.  The file's space is reserved up front, so a full disk is reported
+// before the fill starts instead of faulting part-way through it, and the
+// file is unlinked as soon as it is opened, so it never outlives the run.
+
+#ifndef DIRECTION_SPILL_H
+#define DIRECTION_SPILL_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+class DirectionSpill {
+public:
+    DirectionSpill() : fd(-1), rowBytes(0), tileRows(0), rows(0), tile(-1), map(NULL), mapBytes(0), mapSkew(0) {}
+    ~DirectionSpill() {
+        unmapTile();
+        if(fd >= 0) close(fd);
+    }
+
+    // Reserve rows x cols directions in a temporary file in dir, mapped
+    // tileBytes (rounded to whole rows) at a time; false with the reason in
+    // error on failure
+    bool open(const std::string& dir, long nRows, long cols, size_t tileBytes, std::string& error) {
+        rows = nRows;
+        rowBytes = (cols + 3) / 4;
+        tileRows = rowBytes > 0 ? std::max(1L, (long)(tileBytes / rowBytes)) : 1;
+        std::string path = dir + "/swDirections.XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        fd = mkstemp(name.data());
+        if(fd < 0) {
+            error = "unable to create a file in " + dir + ": " + std::strerror(errno);
+            return false;
+        }
+        unlink(name.data());
+        off_t bytes = (off_t)rows * rowBytes;
+        int err = bytes > 0 ? posix_fallocate(fd, 0, bytes) : 0;
+        if(err != 0) {
+            error = "unable to reserve " + std::to_string((long long)bytes) + " bytes in " + dir + ": " +
+                    std::strerror(err);
+            return false;
+        }
+        return true;
+    }
+
+    // Packed directions of one row, mapping its tile if needed; NULL if the
+    // tile cannot be mapped
+    unsigned char *row(long r) {
+        long t = r / tileRows;
+        if(t != tile && !mapTile(t)) return NULL;
+        return map + mapSkew + (size_t)(r - t * tileRows) * rowBytes;
+    }
+
+    static void set(unsigned char *packed, long j, unsigned char d) {
+        packed[j >> 2] |= d << ((j & 3) * 2);
+    }
+    static unsigned char get(const unsigned char *packed, long j) {
+        return (packed[j >> 2] >> ((j & 3) * 2)) & 3;
+    }
+
+    size_t fileBytes() const { return (size_t)rows * rowBytes; }
+
+private:
+    bool mapTile(long t) {
+        unmapTile();
+        long firstRow = t * tileRows;
+        long nRows = std::min(tileRows, rows - firstRow);
+        off_t offset = (off_t)firstRow * rowBytes;
+        off_t aligned = offset - offset % sysconf(_SC_PAGESIZE);
+        mapSkew = offset - aligned;
+        mapBytes = mapSkew + (size_t)nRows * rowBytes;
+        void *p = mmap(NULL, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, aligned);
+        if(p == MAP_FAILED) return false;
+        map = static_cast<unsigned char *>(p);
+        tile = t;
+        return true;
+    }
+
+    void unmapTile() {
+        if(map) munmap(map, mapBytes);
+        map = NULL;
+        tile = -1;
+    }
+
+    int fd;
+    size_t rowBytes;
+    long tileRows;
+    long rows;
+    long tile;                  // tile mapped now, or -1
+    unsigned char *map;
+    size_t mapBytes;
+    size_t mapSkew;             // bytes mapped before the tile, for page alignment
+};
+
+#endif // DIRECTION_SPILL_H
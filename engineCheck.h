@@ -0,0 +1,156 @@
+// engineCheck.h - Pairs and reproducers for cross-checking alignment engines
+//
+// cpuSmithWaterman --check runs every alignment engine it has on the same
+// pairs and compares each with the reference, the byte-compare kernel
+// alignGeneral(): score, end cell, aligned strings and MSF bytes must all be
+// identical, so a fast path that breaks a tie between diagonal, up and left
+// differently is caught too.  The pairs are random protein and DNA pairs plus
+// adversarial ones built to produce ties and edge cases: tiny alphabets,
+// homopolymer runs, periodic repeats, mutated copies, single residues, pairs
+// with nothing in common and pairs outside the DNA and protein alphabets.
+//
+// A failing pair is shrunk, by dropping and simplifying residues while the
+// engine still disagrees, and appended to a corpus file that later runs
+// replay first.  A corpus line is "<mode> <seq1> <seq2>".
+
+#ifndef ENGINE_CHECK_H
+#define ENGINE_CHECK_H
+
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+struct CheckCase {
+    std::string mode;       // local, global, semiglobal or glocal
+    std::string seq1;
+    std::string seq2;
+};
+
+inline std::string randomResidues(std::mt19937& rng, const std::string& alphabet, int length) {
+    std::uniform_int_distribution<int> pick(0, (int)alphabet.size() - 1);
+    std::string seq;
+    for(int k = 0; k < length; ++k) seq.push_back(alphabet[pick(rng)]);
+    return seq;
+}
+
+// A copy of seq with point substitutions, insertions and deletions
+inline std::string mutateResidues(std::mt19937& rng, const std::string& seq,
+                                  const std::string& alphabet, double rate) {
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::string out;
+    for(char c : seq) {
+        double r = chance(rng);
+        if(r < rate / 3) continue;
+        if(r < 2 * rate / 3) out += randomResidues(rng, alphabet, 1);
+        else out.push_back(c);
+        if(chance(rng) < rate / 3) out += randomResidues(rng, alphabet, 1);
+    }
+    return out.empty() ? seq.substr(0, 1) : out;
+}
+
+// The k-th generated pair; kinds rotate so every run covers all of them
+inline CheckCase generateCheckCase(std::mt19937& rng, long k, int maxLength) {
+    static const char *modes[] = { "local", "global", "semiglobal", "glocal" };
+    const std::string protein = "ACDEFGHIKLMNPQRSTVWY";
+    const std::string dna = "ACGT";
+    std::uniform_int_distribution<int> length(1, maxLength);
+    CheckCase c;
+    c.mode = modes[k % 4];
+    switch((k / 4) % 10) {
+    case 0:
+        c.seq1 = randomResidues(rng, protein, length(rng));
+        c.seq2 = randomResidues(rng, protein, length(rng));
+        break;
+    case 1:
+        c.seq1 = randomResidues(rng, dna, length(rng));
+        c.seq2 = randomResidues(rng, dna, length(rng));
+        break;
+    case 2:     // two letters: ties everywhere
+        c.seq1 = randomResidues(rng, "AB", length(rng));
+        c.seq2 = randomResidues(rng, "AB", length(rng));
+        break;
+    case 3:     // homopolymer runs of different lengths
+        c.seq1 = std::string(length(rng), 'A');
+        c.seq2 = std::string(length(rng), 'A');
+        break;
+    case 4: {   // periodic repeats, out of phase
+        std::string unit = randomResidues(rng, dna, 1 + k % 3);
+        std::string seq;
+        while((int)seq.size() < maxLength + 3) seq += unit;
+        c.seq1 = seq.substr(0, length(rng));
+        c.seq2 = seq.substr(1, length(rng));
+        break;
+    }
+    case 5:     // homologues
+        c.seq1 = randomResidues(rng, protein, length(rng));
+        c.seq2 = mutateResidues(rng, c.seq1, protein, 0.3);
+        break;
+    case 6:     // identical
+        c.seq1 = c.seq2 = randomResidues(rng, protein, length(rng));
+        break;
+    case 7:     // nothing in common
+        c.seq1 = randomResidues(rng, "ACGT", length(rng));
+        c.seq2 = randomResidues(rng, "WY", length(rng));
+        break;
+    case 8:     // letters outside both alphabets, for the general kernel
+        c.seq1 = randomResidues(rng, "ACJOU", length(rng));
+        c.seq2 = randomResidues(rng, "ACGTJ", length(rng));
+        break;
+    default:    // a single residue against a sequence
+        c.seq1 = randomResidues(rng, dna, 1);
+        c.seq2 = randomResidues(rng, dna, length(rng));
+        if(k % 8 >= 4) std::swap(c.seq1, c.seq2);
+        break;
+    }
+    return c;
+}
+
+// Shrink a failing case while fails() still holds: drop blocks of residues,
+// halving the block size down to one, then turn residues into 'A'
+inline CheckCase shrinkCheckCase(CheckCase c, const std::function<bool(const CheckCase&)>& fails) {
+    bool shrunk = true;
+    while(shrunk) {
+        shrunk = false;
+        for(int which = 0; which < 2; ++which) {
+            std::string& seq = which == 0 ? c.seq1 : c.seq2;
+            for(size_t block = seq.size() / 2; block >= 1; block /= 2) {
+                for(size_t at = 0; at + block <= seq.size() && seq.size() > block; ) {
+                    std::string saved = seq;
+                    seq.erase(at, block);
+                    if(fails(c)) {
+                        shrunk = true;
+                    } else {
+                        seq = saved;
+                        at += block;
+                    }
+                }
+            }
+            for(size_t at = 0; at < seq.size(); ++at) {
+                if(seq[at] == 'A') continue;
+                char saved = seq[at];
+                seq[at] = 'A';
+                if(fails(c)) shrunk = true;
+                else seq[at] = saved;
+            }
+        }
+    }
+    return c;
+}
+
+inline std::vector<CheckCase> readCheckCorpus(const std::string& path) {
+    std::vector<CheckCase> cases;
+    std::ifstream fin(path);
+    CheckCase c;
+    while(fin >> c.mode >> c.seq1 >> c.seq2) cases.push_back(c);
+    return cases;
+}
+
+inline bool appendCheckCorpus(const std::string& path, const CheckCase& c) {
+    std::ofstream fout(path, std::ios::app);
+    fout << c.mode << ' ' << c.seq1 << ' ' << c.seq2 << '\n';
+    return static_cast<bool>(fout);
+}
+
+#endif // ENGINE_CHECK_H
@@ -244,9 +244,94 @@ int sb_charMatches(const ENCODING *enc, const char *p, int c)
 #define CHAR_MATCHES(enc, p, c) (*(p) == c)
 #endif
 
+#if !defined(XML_MIN_SIZE) && defined(__SSE2__)
+
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Returns the offset of the lowest set bit of a non-zero movemask. */
+#ifdef __GNUC__
+#define SB_FIRST_STOP(mask) __builtin_ctz(mask)
+#else
+static
+int sb_firstStop(unsigned mask)
+{
+  int n = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    n++;
+  }
+  return n;
+}
+#define SB_FIRST_STOP(mask) sb_firstStop(mask)
+#endif
+
+/* Skips a run of plain character data in an ASCII-compatible encoding,
+16 (or 32 with AVX2) bytes at a time.  A byte is plain when it is
+printable ASCII other than '<', '&' and ']', or a tab; anything else
+(markup, CR/LF, control characters, non-ASCII lead or trail bytes)
+stops the scan so that contentTok classifies it through BYTE_TYPE as
+before.  Fewer than 16 trailing bytes are always left to the caller. */
+
+static
+const char *sb_skipDataChars(const char *ptr, const char *end)
+{
+  const __m128i lt = _mm_set1_epi8(ASCII_LT);
+  const __m128i amp = _mm_set1_epi8(ASCII_AMP);
+  const __m128i rsqb = _mm_set1_epi8(ASCII_RSQB);
+  const __m128i tab = _mm_set1_epi8(ASCII_TAB);
+  const __m128i space = _mm_set1_epi8(ASCII_SPACE);
+  unsigned mask;
+#ifdef __AVX2__
+  const __m256i lt32 = _mm256_set1_epi8(ASCII_LT);
+  const __m256i amp32 = _mm256_set1_epi8(ASCII_AMP);
+  const __m256i rsqb32 = _mm256_set1_epi8(ASCII_RSQB);
+  const __m256i tab32 = _mm256_set1_epi8(ASCII_TAB);
+  const __m256i space32 = _mm256_set1_epi8(ASCII_SPACE);
+  while (end - ptr >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)ptr);
+    /* signed compare: bytes >= 0x80 are negative and so also count
+       as below space */
+    __m256i stop = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab32),
+                                       _mm256_cmpgt_epi8(space32, v));
+    stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, lt32));
+    stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, amp32));
+    stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(v, rsqb32));
+    mask = (unsigned)_mm256_movemask_epi8(stop);
+    if (mask)
+      return ptr + SB_FIRST_STOP(mask);
+    ptr += 32;
+  }
+#endif
+  while (end - ptr >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)ptr);
+    __m128i stop = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab),
+                                    _mm_cmplt_epi8(v, space));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, lt));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, amp));
+    stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, rsqb));
+    mask = (unsigned)_mm_movemask_epi8(stop);
+    if (mask)
+      return ptr + SB_FIRST_STOP(mask);
+    ptr += 16;
+  }
+  return ptr;
+}
+
+/* Only encodings whose bytes below 0x80 are ASCII may take the fast
+path; user-defined encodings built on the latin1 table are excluded
+by isUtf8. */
+#define SKIP_DATA_CHARS(enc, ptr, end) \
+  ((enc)->isUtf8 ? sb_skipDataChars(ptr, end) : (ptr))
+
+#endif /* !XML_MIN_SIZE && __SSE2__ */
+
 #define PREFIX(ident) normal_ ## ident
 #include "xmltok_impl.c"
 
+#undef SKIP_DATA_CHARS
 #undef MINBPC
 #undef BYTE_TYPE
 #undef BYTE_TO_ASCII
@@ -0,0 +1,289 @@
+/*
+Copyright (c) 1998, 1999 Thai Open Source Software Center Ltd
+See the file COPYING for copying permission.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include "expat.h"
+#include "xmlbench.h"
+#include "xmltchar.h"
+#include "filemap.h"
+
+#ifdef _MSC_VER
+#include <io.h>
+#include <time.h>
+#else
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+#ifndef O_BINARY
+#ifdef _O_BINARY
+#define O_BINARY _O_BINARY
+#else
+#define O_BINARY 0
+#endif
+#endif
+
+#define MB (1024.0*1024.0)
+
+typedef struct {
+  double bytes;
+  double seconds;
+  double best;
+  unsigned long allocs;
+  int failed;
+} BENCH_STATS;
+
+typedef struct {
+  const XML_Char *encoding;
+  int useNamespaces;
+  int iterations;
+  BENCH_STATS *stats;
+} BENCH_ARGS;
+
+/* Every malloc and realloc the parser makes goes through these, so
+the count covers the parser itself, its pools and its buffer. */
+
+static unsigned long allocCount;
+
+static
+void *countMalloc(size_t size)
+{
+  allocCount++;
+  return malloc(size);
+}
+
+static
+void *countRealloc(void *ptr, size_t size)
+{
+  allocCount++;
+  return realloc(ptr, size);
+}
+
+static const XML_Memory_Handling_Suite countingSuite = {
+  countMalloc, countRealloc, free
+};
+
+double XML_BenchClock(void)
+{
+#ifdef _MSC_VER
+  return (double)clock() / CLOCKS_PER_SEC;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+static void nopStartElement(void *userData, const XML_Char *name, const XML_Char **atts) { }
+static void nopEndElement(void *userData, const XML_Char *name) { }
+static void nopCharacterData(void *userData, const XML_Char *s, int len) { }
+
+/* Parsers are set up the way xmlwf -t sets them up, so the numbers
+include the cost of reporting every element and run of text. */
+
+static
+XML_Parser createParser(const BENCH_ARGS *args)
+{
+  static const XML_Char nsSep[] = { T('\001'), T('\0') };
+  XML_Parser parser = XML_ParserCreate_MM(args->encoding, &countingSuite,
+					  args->useNamespaces ? nsSep : 0);
+  if (!parser)
+    return 0;
+  XML_SetElementHandler(parser, nopStartElement, nopEndElement);
+  XML_SetCharacterDataHandler(parser, nopCharacterData);
+  return parser;
+}
+
+static
+void reportError(XML_Parser parser, const XML_Char *filename)
+{
+  int code = XML_GetErrorCode(parser);
+  const XML_Char *message = XML_ErrorString(code);
+  if (message)
+    ftprintf(stderr, T("%s:%d:%d: %s\n"),
+	     filename,
+	     XML_GetErrorLineNumber(parser),
+	     XML_GetErrorColumnNumber(parser),
+	     message);
+  else
+    ftprintf(stderr, T("%s: (unknown message %d)\n"), filename, code);
+}
+
+static
+void addPass(BENCH_STATS *stats, double bytes, double seconds,
+	     unsigned long allocs)
+{
+  stats->bytes += bytes;
+  stats->seconds += seconds;
+  if (stats->best == 0 || seconds < stats->best)
+    stats->best = seconds;
+  stats->allocs += allocs;
+}
+
+static
+void benchMapped(const void *data,
+		 size_t size,
+		 const XML_Char *filename,
+		 void *arg)
+{
+  const BENCH_ARGS *args = arg;
+  int n;
+  for (n = 0; n < args->iterations; n++) {
+    unsigned long allocs = allocCount;
+    double start = XML_BenchClock();
+    XML_Parser parser = createParser(args);
+    if (!parser) {
+      ftprintf(stderr, T("%s: out of memory\n"), filename);
+      args->stats->failed = 1;
+      return;
+    }
+    if (!XML_Parse(parser, data, size, 1)) {
+      reportError(parser, filename);
+      XML_ParserFree(parser);
+      args->stats->failed = 1;
+      return;
+    }
+    XML_ParserFree(parser);
+    addPass(args->stats, (double)size, XML_BenchClock() - start, allocCount - allocs);
+  }
+}
+
+/* This is processStream in xmlfile.c with the chunk size as a
+parameter; the file is opened afresh on every pass. */
+
+static
+int benchStream(const XML_Char *filename, int chunkSize,
+		const BENCH_ARGS *args)
+{
+  int n;
+  for (n = 0; n < args->iterations; n++) {
+    unsigned long allocs = allocCount;
+    double bytes = 0;
+    double start = XML_BenchClock();
+    int ok = 0;
+    XML_Parser parser;
+    int fd = topen(filename, O_BINARY|O_RDONLY);
+    if (fd < 0) {
+      tperror(filename);
+      return 0;
+    }
+    parser = createParser(args);
+    if (!parser) {
+      close(fd);
+      ftprintf(stderr, T("%s: out of memory\n"), filename);
+      return 0;
+    }
+    for (;;) {
+      int nread;
+      char *buf = XML_GetBuffer(parser, chunkSize);
+      if (!buf) {
+	ftprintf(stderr, T("%s: out of memory\n"), filename);
+	break;
+      }
+      nread = read(fd, buf, chunkSize);
+      if (nread < 0) {
+	tperror(filename);
+	break;
+      }
+      if (!XML_ParseBuffer(parser, nread, nread == 0)) {
+	reportError(parser, filename);
+	break;
+      }
+      if (nread == 0) {
+	ok = 1;
+	break;
+      }
+      bytes += nread;
+    }
+    close(fd);
+    XML_ParserFree(parser);
+    if (!ok)
+      return 0;
+    addPass(args->stats, bytes, XML_BenchClock() - start, allocCount - allocs);
+  }
+  return 1;
+}
+
+static
+double rate(double bytes, double seconds)
+{
+  return seconds > 0 ? bytes / MB / seconds : 0;
+}
+
+static
+void printStats(const XML_Char *name, int chunkSize,
+		const BENCH_STATS *stats, int iterations)
+{
+  if (chunkSize)
+    ftprintf(stdout, T("%-24s read %8d"), name, chunkSize);
+  else
+    ftprintf(stdout, T("%-24s map  %8s"), name, T("-"));
+  if (stats->failed) {
+    ftprintf(stdout, T("  failed\n"));
+    return;
+  }
+  ftprintf(stdout, T(" %10.1f %10.1f %10.1f\n"),
+	   rate(stats->bytes, stats->seconds),
+	   rate(stats->bytes / iterations, stats->best),
+	   stats->bytes > 0 ? stats->allocs / (stats->bytes / MB) : 0);
+}
+
+int XML_BenchmarkFiles(int nFiles,
+		       XML_Char **files,
+		       int iterations,
+		       const int *chunkSizes,
+		       int nChunkSizes,
+		       const XML_Char *encoding,
+		       int useNamespaces)
+{
+  BENCH_STATS total[XML_BENCH_MAX_CHUNKS + 1];
+  BENCH_ARGS args;
+  int result = 1;
+  int i, k;
+
+  memset(total, 0, sizeof(total));
+  args.encoding = encoding;
+  args.useNamespaces = useNamespaces;
+  args.iterations = iterations;
+
+  ftprintf(stdout, T("%-24s %-4s %8s %10s %10s %10s\n"),
+	   T("file"), T("mode"), T("chunk"), T("MB/s"), T("best MB/s"),
+	   T("allocs/MB"));
+  for (i = 0; i < nFiles; i++) {
+    for (k = 0; k <= nChunkSizes; k++) {
+      BENCH_STATS stats;
+      memset(&stats, 0, sizeof(stats));
+      args.stats = &stats;
+      if (k == 0) {
+	if (!filemap(files[i], benchMapped, &args))
+	  stats.failed = 1;
+      }
+      else if (!benchStream(files[i], chunkSizes[k - 1], &args))
+	stats.failed = 1;
+      printStats(files[i], k ? chunkSizes[k - 1] : 0, &stats, iterations);
+      if (stats.failed) {
+	total[k].failed = 1;
+	result = 0;
+      }
+      else {
+	total[k].bytes += stats.bytes;
+	total[k].seconds += stats.seconds;
+	total[k].best += stats.best;
+	total[k].allocs += stats.allocs;
+      }
+    }
+  }
+  if (nFiles > 1) {
+    /* The corpus best is the sum of each file's fastest pass. */
+    for (k = 0; k <= nChunkSizes; k++)
+      printStats(T("(total)"), k ? chunkSizes[k - 1] : 0, &total[k],
+		 iterations);
+  }
+  return result;
+}
@@ -0,0 +1,24 @@
+/*
+Copyright (c) 1998, 1999 Thai Open Source Software Center Ltd
+See the file COPYING for copying permission.
+*/
+
+#define XML_BENCH_MAX_CHUNKS 8
+
+/* Parses each of the nFiles files iterations times with every input
+strategy: the whole file through filemap, then read() into
+XML_GetBuffer once for each of the nChunkSizes chunk sizes.  Prints
+MB/s and parser allocations per MB for each file and for the corpus
+as a whole.  Returns 1 if every parse succeeded, 0 otherwise. */
+
+extern int XML_BenchmarkFiles(int nFiles,
+			      XML_Char **files,
+			      int iterations,
+			      const int *chunkSizes,
+			      int nChunkSizes,
+			      const XML_Char *encoding,
+			      int useNamespaces);
+
+/* Returns wall-clock seconds from an arbitrary origin. */
+
+extern double XML_BenchClock(void);
@@ -39,16 +39,25 @@ See the file COPYING for copying permission.
 
 typedef struct {
   XML_Parser parser;
+  FILE *report;
   int *retPtr;
 } PROCESS_ARGS;
 
+/* This is the external entity reference handler argument, so that
+the handlers can find both the parser and where to report errors. */
+
+typedef struct {
+  XML_Parser parser;
+  FILE *report;
+} ENTITY_ARGS;
+
 static
-void reportError(XML_Parser parser, const XML_Char *filename)
+void reportError(XML_Parser parser, const XML_Char *filename, FILE *report)
 {
   int code = XML_GetErrorCode(parser);
   const XML_Char *message = XML_ErrorString(code);
   if (message)
-    ftprintf(stdout, T("%s:%d:%d: %s\n"),
+    ftprintf(report, T("%s:%d:%d: %s\n"),
 	     filename,
 	     XML_GetErrorLineNumber(parser),
 	     XML_GetErrorColumnNumber(parser),
@@ -66,7 +75,7 @@ void processFile(const void *data,
   XML_Parser parser = ((PROCESS_ARGS *)args)->parser;
   int *retPtr = ((PROCESS_ARGS *)args)->retPtr;
   if (!XML_Parse(parser, data, size, 1)) {
-    reportError(parser, filename);
+    reportError(parser, filename, ((PROCESS_ARGS *)args)->report);
     *retPtr = 0;
   }
   else
@@ -112,7 +121,7 @@ const XML_Char *resolveSystemId(const XML_Char *base, const XML_Char *systemId,
 }
 
 static
-int externalEntityRefFilemap(XML_Parser parser,
+int externalEntityRefFilemap(XML_Parser arg,
 			     const XML_Char *context,
 			     const XML_Char *base,
 			     const XML_Char *systemId,
@@ -121,10 +130,16 @@ int externalEntityRefFilemap(XML_Parser parser,
   int result;
   XML_Char *s;
   const XML_Char *filename;
-  XML_Parser entParser = XML_ExternalEntityParserCreate(parser, context, 0);
+  ENTITY_ARGS *outer = (ENTITY_ARGS *)arg;
+  XML_Parser entParser = XML_ExternalEntityParserCreate(outer->parser, context, 0);
+  ENTITY_ARGS entArgs;
   PROCESS_ARGS args;
+  entArgs.parser = entParser;
+  entArgs.report = outer->report;
+  XML_SetExternalEntityRefHandlerArg(entParser, &entArgs);
   args.retPtr = &result;
   args.parser = entParser;
+  args.report = outer->report;
   filename = resolveSystemId(base, systemId, &s);
   XML_SetBase(entParser, filename);
   if (!filemap(filename, processFile, &args))
@@ -135,7 +150,7 @@ int externalEntityRefFilemap(XML_Parser parser,
 }
 
 static
-int processStream(const XML_Char *filename, XML_Parser parser)
+int processStream(const XML_Char *filename, XML_Parser parser, FILE *report)
 {
   int fd = topen(filename, O_BINARY|O_RDONLY);
   if (fd < 0) {
@@ -157,7 +172,7 @@ int processStream(const XML_Char *filename, XML_Parser parser)
       return 0;
     }
     if (!XML_ParseBuffer(parser, nread, nread == 0)) {
-      reportError(parser, filename);
+      reportError(parser, filename, report);
       close(fd);
       return 0;
     }
@@ -170,7 +185,7 @@ int processStream(const XML_Char *filename, XML_Parser parser)
 }
 
 static
-int externalEntityRefStream(XML_Parser parser,
+int externalEntityRefStream(XML_Parser arg,
 			    const XML_Char *context,
 			    const XML_Char *base,
 			    const XML_Char *systemId,
@@ -179,10 +194,15 @@ int externalEntityRefStream(XML_Parser parser,
   XML_Char *s;
   const XML_Char *filename;
   int ret;
-  XML_Parser entParser = XML_ExternalEntityParserCreate(parser, context, 0);
+  ENTITY_ARGS *outer = (ENTITY_ARGS *)arg;
+  XML_Parser entParser = XML_ExternalEntityParserCreate(outer->parser, context, 0);
+  ENTITY_ARGS entArgs;
+  entArgs.parser = entParser;
+  entArgs.report = outer->report;
+  XML_SetExternalEntityRefHandlerArg(entParser, &entArgs);
   filename = resolveSystemId(base, systemId, &s);
   XML_SetBase(entParser, filename);
-  ret = processStream(filename, entParser);
+  ret = processStream(filename, entParser, outer->report);
   free(s);
   XML_ParserFree(entParser);
   return ret;
@@ -191,27 +211,41 @@ int externalEntityRefStream(XML_Parser parser,
 int XML_ProcessFile(XML_Parser parser,
 		    const XML_Char *filename,
 		    unsigned flags)
+{
+  return XML_ProcessFileReport(parser, filename, flags, stdout);
+}
+
+int XML_ProcessFileReport(XML_Parser parser,
+			  const XML_Char *filename,
+			  unsigned flags,
+			  FILE *report)
 {
   int result;
+  ENTITY_ARGS entArgs;
 
   if (!XML_SetBase(parser, filename)) {
     ftprintf(stderr, T("%s: out of memory"), filename);
     exit(1);
   }
 
-  if (flags & XML_EXTERNAL_ENTITIES)
+  if (flags & XML_EXTERNAL_ENTITIES) {
+      entArgs.parser = parser;
+      entArgs.report = report;
       XML_SetExternalEntityRefHandler(parser,
 	                              (flags & XML_MAP_FILE)
 				      ? externalEntityRefFilemap
 				      : externalEntityRefStream);
+      XML_SetExternalEntityRefHandlerArg(parser, &entArgs);
+  }
   if (flags & XML_MAP_FILE) {
     PROCESS_ARGS args;
     args.retPtr = &result;
     args.parser = parser;
+    args.report = report;
     if (!filemap(filename, processFile, &args))
       result = 0;
   }
   else
-    result = processStream(filename, parser);
+    result = processStream(filename, parser, report);
   return result;
 }
@@ -9,3 +9,11 @@ See the file COPYING for copying permission.
 extern int XML_ProcessFile(XML_Parser parser,
 			   const XML_Char *filename,
 			   unsigned flags);
+
+/* As XML_ProcessFile, but parse errors, including those in external
+entities, are written to report rather than stdout. */
+
+extern int XML_ProcessFileReport(XML_Parser parser,
+				 const XML_Char *filename,
+				 unsigned flags,
+				 FILE *report);
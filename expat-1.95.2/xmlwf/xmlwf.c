@@ -11,12 +11,20 @@ See the file COPYING for copying permission.
 #include "expat.h"
 #include "codepage.h"
 #include "xmlfile.h"
+#include "xmlbench.h"
 #include "xmltchar.h"
 
 #ifdef _MSC_VER
 #include <crtdbg.h>
 #endif
 
+#ifndef WIN32
+#define XMLWF_THREADS
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
 /* This ensures proper sorting. */
 
 #define NSSEP T('\001')
@@ -563,10 +571,284 @@ int notStandalone(void *userData)
 static
 void usage(const XML_Char *prog)
 {
-  ftprintf(stderr, T("usage: %s [-n] [-p] [-r] [-s] [-w] [-x] [-d output-dir] [-e encoding] file ...\n"), prog);
+  ftprintf(stderr, T("usage: %s [-n] [-p] [-r] [-s] [-w] [-x] [-d output-dir] [-e encoding] [-j threads] file ...\n"), prog);
+  ftprintf(stderr, T("       %s -b iterations [-k chunk-size,...] [-n] [-e encoding] file ...\n"), prog);
   exit(1);
 }
 
+/* Parses a positive decimal number, leaving *end just past it.
+Returns 0 if s does not start with one. */
+
+static
+int parseNumber(const XML_Char *s, const XML_Char **end)
+{
+  static const XML_Char digits[] = T("0123456789");
+  int n = 0;
+  for (; *s; s++) {
+    const XML_Char *d = tcschr(digits, *s);
+    if (!d)
+      break;
+    n = n * 10 + (d - digits);
+    if (n >= 0x10000000)
+      return 0;
+  }
+  *end = s;
+  return n;
+}
+
+static
+int parseChunkSizes(const XML_Char *s, int *chunkSizes)
+{
+  int n = 0;
+  for (;;) {
+    if (n == XML_BENCH_MAX_CHUNKS)
+      return 0;
+    chunkSizes[n] = parseNumber(s, &s);
+    if (chunkSizes[n++] == 0)
+      return 0;
+    if (*s == T('\0'))
+      return n;
+    if (*s++ != T(','))
+      return 0;
+  }
+}
+
+typedef struct {
+  const XML_Char *outputDir;
+  const XML_Char *encoding;
+  unsigned processFlags;
+  int windowsCodePages;
+  int outputType;
+  int useNamespaces;
+  int requireStandalone;
+  int paramEntityParsing;
+} XMLWF_OPTIONS;
+
+static
+int processOneFile(const XML_Char *filename, const XMLWF_OPTIONS *opts,
+		   FILE *report)
+{
+  FILE *fp = 0;
+  XML_Char *outName = 0;
+  int result;
+  XML_Parser parser;
+  if (opts->useNamespaces)
+    parser = XML_ParserCreateNS(opts->encoding, NSSEP);
+  else
+    parser = XML_ParserCreate(opts->encoding);
+  if (opts->requireStandalone)
+    XML_SetNotStandaloneHandler(parser, notStandalone);
+  XML_SetParamEntityParsing(parser, opts->paramEntityParsing);
+  if (opts->outputType == 't') {
+    /* This is for doing timings; this gives a more realistic estimate of
+       the parsing time. */
+    XML_SetElementHandler(parser, nopStartElement, nopEndElement);
+    XML_SetCharacterDataHandler(parser, nopCharacterData);
+    XML_SetProcessingInstructionHandler(parser, nopProcessingInstruction);
+  }
+  else if (opts->outputDir) {
+    const XML_Char *file = filename;
+    if (tcsrchr(file, T('/')))
+      file = tcsrchr(file, T('/')) + 1;
+#ifdef WIN32
+    if (tcsrchr(file, T('\\')))
+      file = tcsrchr(file, T('\\')) + 1;
+#endif
+    outName = malloc((tcslen(opts->outputDir) + tcslen(file) + 2) * sizeof(XML_Char));
+    tcscpy(outName, opts->outputDir);
+    tcscat(outName, T("/"));
+    tcscat(outName, file);
+    fp = tfopen(outName, T("wb"));
+    if (!fp) {
+      tperror(outName);
+      exit(1);
+    }
+    setvbuf(fp, NULL, _IOFBF, 16384);
+#ifdef XML_UNICODE
+    puttc(0xFEFF, fp);
+#endif
+    XML_SetUserData(parser, fp);
+    switch (opts->outputType) {
+    case 'm':
+      XML_UseParserAsHandlerArg(parser);
+      XML_SetElementHandler(parser, metaStartElement, metaEndElement);
+      XML_SetProcessingInstructionHandler(parser, metaProcessingInstruction);
+      XML_SetCommentHandler(parser, metaComment);
+      XML_SetCdataSectionHandler(parser, metaStartCdataSection, metaEndCdataSection);
+      XML_SetCharacterDataHandler(parser, metaCharacterData);
+      XML_SetDoctypeDeclHandler(parser, metaStartDoctypeDecl, metaEndDoctypeDecl);
+      XML_SetEntityDeclHandler(parser, metaEntityDecl);
+      XML_SetNotationDeclHandler(parser, metaNotationDecl);
+      XML_SetNamespaceDeclHandler(parser, metaStartNamespaceDecl, metaEndNamespaceDecl);
+      metaStartDocument(parser);
+      break;
+    case 'c':
+      XML_UseParserAsHandlerArg(parser);
+      XML_SetDefaultHandler(parser, markup);
+      XML_SetElementHandler(parser, defaultStartElement, defaultEndElement);
+      XML_SetCharacterDataHandler(parser, defaultCharacterData);
+      XML_SetProcessingInstructionHandler(parser, defaultProcessingInstruction);
+      break;
+    default:
+      if (opts->useNamespaces)
+	XML_SetElementHandler(parser, startElementNS, endElementNS);
+      else
+	XML_SetElementHandler(parser, startElement, endElement);
+      XML_SetCharacterDataHandler(parser, characterData);
+#ifndef W3C14N
+      XML_SetProcessingInstructionHandler(parser, processingInstruction);
+#endif /* not W3C14N */
+      break;
+    }
+  }
+  if (opts->windowsCodePages)
+    XML_SetUnknownEncodingHandler(parser, unknownEncoding, 0);
+  result = XML_ProcessFileReport(parser, filename, opts->processFlags, report);
+  if (opts->outputDir) {
+    if (opts->outputType == 'm')
+      metaEndDocument(parser);
+    fclose(fp);
+    if (!result)
+      tremove(outName);
+    free(outName);
+  }
+  XML_ParserFree(parser);
+  return result;
+}
+
+#ifdef XMLWF_THREADS
+
+/* With -j, files are handed out in command-line order to a fixed
+set of worker threads, each using its own parser.  A worker writes
+the errors for a file to a temporary file, and the main thread copies
+those to stdout in command-line order as each file completes, so the
+output is the same as when files are processed one at a time. */
+
+typedef struct {
+  const XML_Char *filename;
+  FILE *report;
+  int done;
+  double bytes;
+  double seconds;
+} JOB;
+
+typedef struct {
+  JOB *jobs;
+  int nJobs;
+  int next;
+  const XMLWF_OPTIONS *opts;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+} JOB_QUEUE;
+
+static
+void *worker(void *arg)
+{
+  JOB_QUEUE *queue = arg;
+  for (;;) {
+    JOB *job;
+    struct stat sb;
+    double start;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next == queue->nJobs) {
+      pthread_mutex_unlock(&queue->lock);
+      return 0;
+    }
+    job = &queue->jobs[queue->next++];
+    pthread_mutex_unlock(&queue->lock);
+    job->report = tmpfile();
+    start = XML_BenchClock();
+    processOneFile(job->filename, queue->opts,
+		   job->report ? job->report : stdout);
+    job->seconds = XML_BenchClock() - start;
+    if (stat(job->filename, &sb) == 0)
+      job->bytes = (double)sb.st_size;
+    pthread_mutex_lock(&queue->lock);
+    job->done = 1;
+    pthread_cond_broadcast(&queue->finished);
+    pthread_mutex_unlock(&queue->lock);
+  }
+}
+
+static
+void copyReport(FILE *report)
+{
+  char buf[1024*8];
+  size_t n;
+  rewind(report);
+  while ((n = fread(buf, 1, sizeof(buf), report)) > 0)
+    fwrite(buf, 1, n, stdout);
+  fclose(report);
+}
+
+static
+void processFilesParallel(int nFiles, XML_Char **files,
+			  const XMLWF_OPTIONS *opts, int nThreads)
+{
+  JOB_QUEUE queue;
+  pthread_t *threads;
+  double start = XML_BenchClock();
+  double bytes = 0;
+  double busy = 0;
+  double elapsed;
+  int i;
+
+  if (nThreads > nFiles)
+    nThreads = nFiles;
+  queue.jobs = calloc(nFiles, sizeof(JOB));
+  threads = malloc(nThreads * sizeof(pthread_t));
+  if (!queue.jobs || !threads) {
+    ftprintf(stderr, T("out of memory\n"));
+    exit(1);
+  }
+  queue.nJobs = nFiles;
+  queue.next = 0;
+  queue.opts = opts;
+  pthread_mutex_init(&queue.lock, 0);
+  pthread_cond_init(&queue.finished, 0);
+  for (i = 0; i < nFiles; i++)
+    queue.jobs[i].filename = files[i];
+  for (i = 0; i < nThreads; i++) {
+    if (pthread_create(&threads[i], 0, worker, &queue) != 0) {
+      if (i == 0) {
+	ftprintf(stderr, T("cannot create threads\n"));
+	exit(1);
+      }
+      nThreads = i;
+      break;
+    }
+  }
+  for (i = 0; i < nFiles; i++) {
+    JOB *job = &queue.jobs[i];
+    pthread_mutex_lock(&queue.lock);
+    while (!job->done)
+      pthread_cond_wait(&queue.finished, &queue.lock);
+    pthread_mutex_unlock(&queue.lock);
+    if (job->report)
+      copyReport(job->report);
+    bytes += job->bytes;
+    busy += job->seconds;
+  }
+  for (i = 0; i < nThreads; i++)
+    pthread_join(threads[i], 0);
+  elapsed = XML_BenchClock() - start;
+  /* busy/wall is the summed per-file parse time over the wall time: how
+     many workers were parsing on average, not a speedup over a serial run,
+     since contention makes each file slower.  Compare the MB/s of -j 1 and
+     -j N runs on the same files for the scaling. */
+  ftprintf(stderr,
+	   T("%d files, %.1f MB in %.2f s with %d threads: %.1f MB/s, busy/wall %.2f\n"),
+	   nFiles, bytes / (1024.0*1024.0), elapsed, nThreads,
+	   elapsed > 0 ? bytes / (1024.0*1024.0) / elapsed : 0,
+	   elapsed > 0 ? busy / elapsed : 0);
+  pthread_cond_destroy(&queue.finished);
+  pthread_mutex_destroy(&queue.lock);
+  free(threads);
+  free(queue.jobs);
+}
+
+#endif /* XMLWF_THREADS */
+
 int tmain(int argc, XML_Char **argv)
 {
   int i, j;
@@ -578,6 +860,11 @@ int tmain(int argc, XML_Char **argv)
   int useNamespaces = 0;
   int requireStandalone = 0;
   int paramEntityParsing = XML_PARAM_ENTITY_PARSING_NEVER;
+  int benchIterations = 0;
+  int chunkSizes[XML_BENCH_MAX_CHUNKS] = { 1024, 1024*8, 1024*64 };
+  int nChunkSizes = 3;
+  int nThreads = 0;
+  XMLWF_OPTIONS opts;
 
 #ifdef _MSC_VER
   _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF|_CRTDBG_LEAK_CHECK_DF);
@@ -643,6 +930,36 @@ int tmain(int argc, XML_Char **argv)
       i++;
       j = 0;
       break;
+    case T('b'):
+    case T('j'):
+    case T('k'):
+      {
+	XML_Char opt = argv[i][j];
+	const XML_Char *arg;
+	const XML_Char *end;
+	if (argv[i][j + 1] == T('\0')) {
+	  if (++i == argc)
+	    usage(argv[0]);
+	  arg = argv[i];
+	}
+	else
+	  arg = argv[i] + j + 1;
+	if (opt == T('b')) {
+	  benchIterations = parseNumber(arg, &end);
+	  if (!benchIterations || *end)
+	    usage(argv[0]);
+	}
+	else if (opt == T('j')) {
+	  nThreads = parseNumber(arg, &end);
+	  if (!nThreads || *end)
+	    usage(argv[0]);
+	}
+	else if (!(nChunkSizes = parseChunkSizes(arg, chunkSizes)))
+	  usage(argv[0]);
+      }
+      i++;
+      j = 0;
+      break;
     case T('e'):
       if (argv[i][j + 1] == T('\0')) {
 	if (++i == argc)
@@ -667,93 +984,25 @@ int tmain(int argc, XML_Char **argv)
   }
   if (i == argc)
     usage(argv[0]);
-  for (; i < argc; i++) {
-    FILE *fp = 0;
-    XML_Char *outName = 0;
-    int result;
-    XML_Parser parser;
-    if (useNamespaces)
-      parser = XML_ParserCreateNS(encoding, NSSEP);
-    else
-      parser = XML_ParserCreate(encoding);
-    if (requireStandalone)
-      XML_SetNotStandaloneHandler(parser, notStandalone);
-    XML_SetParamEntityParsing(parser, paramEntityParsing);
-    if (outputType == 't') {
-      /* This is for doing timings; this gives a more realistic estimate of
-	 the parsing time. */
-      outputDir = 0;
-      XML_SetElementHandler(parser, nopStartElement, nopEndElement);
-      XML_SetCharacterDataHandler(parser, nopCharacterData);
-      XML_SetProcessingInstructionHandler(parser, nopProcessingInstruction);
-    }
-    else if (outputDir) {
-      const XML_Char *file = argv[i];
-      if (tcsrchr(file, T('/')))
-	file = tcsrchr(file, T('/')) + 1;
-#ifdef WIN32
-      if (tcsrchr(file, T('\\')))
-	file = tcsrchr(file, T('\\')) + 1;
-#endif
-      outName = malloc((tcslen(outputDir) + tcslen(file) + 2) * sizeof(XML_Char));
-      tcscpy(outName, outputDir);
-      tcscat(outName, T("/"));
-      tcscat(outName, file);
-      fp = tfopen(outName, T("wb"));
-      if (!fp) {
-	tperror(outName);
-	exit(1);
-      }
-      setvbuf(fp, NULL, _IOFBF, 16384);
-#ifdef XML_UNICODE
-      puttc(0xFEFF, fp);
-#endif
-      XML_SetUserData(parser, fp);
-      switch (outputType) {
-      case 'm':
-	XML_UseParserAsHandlerArg(parser);
-	XML_SetElementHandler(parser, metaStartElement, metaEndElement);
-	XML_SetProcessingInstructionHandler(parser, metaProcessingInstruction);
-	XML_SetCommentHandler(parser, metaComment);
-	XML_SetCdataSectionHandler(parser, metaStartCdataSection, metaEndCdataSection);
-	XML_SetCharacterDataHandler(parser, metaCharacterData);
-	XML_SetDoctypeDeclHandler(parser, metaStartDoctypeDecl, metaEndDoctypeDecl);
-	XML_SetEntityDeclHandler(parser, metaEntityDecl);
-	XML_SetNotationDeclHandler(parser, metaNotationDecl);
-	XML_SetNamespaceDeclHandler(parser, metaStartNamespaceDecl, metaEndNamespaceDecl);
-	metaStartDocument(parser);
-	break;
-      case 'c':
-	XML_UseParserAsHandlerArg(parser);
-	XML_SetDefaultHandler(parser, markup);
-	XML_SetElementHandler(parser, defaultStartElement, defaultEndElement);
-	XML_SetCharacterDataHandler(parser, defaultCharacterData);
-	XML_SetProcessingInstructionHandler(parser, defaultProcessingInstruction);
-	break;
-      default:
-	if (useNamespaces)
-	  XML_SetElementHandler(parser, startElementNS, endElementNS);
-	else
-	  XML_SetElementHandler(parser, startElement, endElement);
-	XML_SetCharacterDataHandler(parser, characterData);
-#ifndef W3C14N
-	XML_SetProcessingInstructionHandler(parser, processingInstruction);
-#endif /* not W3C14N */
-	break;
-      }
-    }
-    if (windowsCodePages)
-      XML_SetUnknownEncodingHandler(parser, unknownEncoding, 0);
-    result = XML_ProcessFile(parser, argv[i], processFlags);
-    if (outputDir) {
-      if (outputType == 'm')
-	metaEndDocument(parser);
-      fclose(fp);
-      if (!result)
-	tremove(outName);
-      free(outName);
-    }
-    XML_ParserFree(parser);
+  if (benchIterations)
+    return !XML_BenchmarkFiles(argc - i, argv + i, benchIterations,
+			       chunkSizes, nChunkSizes,
+			       encoding, useNamespaces);
+  opts.outputDir = outputType == 't' ? 0 : outputDir;
+  opts.encoding = encoding;
+  opts.processFlags = processFlags;
+  opts.windowsCodePages = windowsCodePages;
+  opts.outputType = outputType;
+  opts.useNamespaces = useNamespaces;
+  opts.requireStandalone = requireStandalone;
+  opts.paramEntityParsing = paramEntityParsing;
+#ifdef XMLWF_THREADS
+  if (nThreads) {
+    processFilesParallel(argc - i, argv + i, &opts, nThreads);
+    return 0;
   }
+#endif
+  for (; i < argc; i++)
+    processOneFile(argv[i], &opts, stdout);
   return 0;
 }
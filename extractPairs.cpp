@@ -0,0 +1,114 @@
+// extractPairs.cpp - Recover individual MSF files from a result archive
+//
+// Reads an archive written by cpuSmithWaterman -m <manifest> -o <archive>
+// (see pairArchive.h) through its index, and prints or writes the MSF of
+// individual pairs, e.g. to feed them to bali_score one at a time.  Pairs a
+// --min-score run pruned have no MSF and are skipped.
+//
+// Usage: extractPairs <archive> -l              list the pairs
+//        extractPairs <archive> <label> ...     print the MSF of each pair
+//        extractPairs <archive> -d <dir>        write <dir>/<family>/<label>.msf
+//                                               for every pair, as generateMSF.py does
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "pairArchive.h"
+
+bool makeDirectory(const std::string& path) {
+    return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <archive> -l\n";
+        std::cerr << "       " << argv[0] << " <archive> <label> ...\n";
+        std::cerr << "       " << argv[0] << " <archive> -d <dir>\n";
+        return 1;
+    }
+    std::string archivePath = argv[1];
+    std::string mode = argv[2];
+
+    std::vector<ArchiveEntry> entries;
+    if(!readArchiveIndex(archivePath, entries)) {
+        std::cerr << "Warning: no index " << archiveIndexPath(archivePath) << ", scanning the archive\n";
+        if(!scanArchive(archivePath, entries)) {
+            std::cerr << "Error: unable to read archive " << archivePath << "\n";
+            return 1;
+        }
+    }
+    std::ifstream archive(archivePath, std::ios::binary);
+    if(!archive.is_open()) {
+        std::cerr << "Error: unable to read archive " << archivePath << "\n";
+        return 1;
+    }
+
+    if(mode == "-l") {
+        for(const ArchiveEntry& e : entries) {
+            std::cout << e.label << "\n";
+        }
+        return 0;
+    }
+
+    std::string msf;
+    if(mode == "-d") {
+        if(argc != 4) {
+            std::cerr << "Usage: " << argv[0] << " <archive> -d <dir>\n";
+            return 1;
+        }
+        std::string dir = argv[3];
+        if(!makeDirectory(dir)) {
+            std::cerr << "Error: unable to create " << dir << "\n";
+            return 1;
+        }
+        size_t extracted = 0;
+        for(const ArchiveEntry& e : entries) {
+            if(e.pruned()) continue;
+            std::string famDir = dir + "/" + e.family;
+            std::string path = famDir + "/" + e.label + ".msf";
+            if(!makeDirectory(famDir)) {
+                std::cerr << "Error: unable to create " << famDir << "\n";
+                return 1;
+            }
+            std::ofstream out(path, std::ios::binary);
+            if(!readArchiveRecord(archive, e, msf) || !out.write(msf.data(), msf.size())) {
+                std::cerr << "Error: unable to extract " << e.label << " to " << path << "\n";
+                return 1;
+            }
+            extracted++;
+        }
+        std::cerr << "Extracted " << extracted << " alignments into " << dir;
+        if(extracted < entries.size()) std::cerr << ", " << entries.size() - extracted << " pairs were pruned";
+        std::cerr << "\n";
+        return 0;
+    }
+
+    std::map<std::string, size_t> byLabel;
+    for(size_t k = 0; k < entries.size(); ++k) {
+        byLabel[entries[k].label] = k;
+    }
+    int missing = 0;
+    for(int a = 2; a < argc; ++a) {
+        auto it = byLabel.find(argv[a]);
+        if(it == byLabel.end()) {
+            std::cerr << "Error: " << argv[a] << " is not in " << archivePath << "\n";
+            missing++;
+            continue;
+        }
+        if(entries[it->second].pruned()) {
+            std::cerr << "Warning: " << argv[a] << " was pruned below the run's minimum score\n";
+            continue;
+        }
+        if(!readArchiveRecord(archive, entries[it->second], msf)) {
+            std::cerr << "Error: unable to read " << argv[a] << " from " << archivePath << "\n";
+            return 1;
+        }
+        std::cout << msf;
+    }
+    return missing ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+// memoryBudget.h - Admission of concurrent pairs under a memory budget
+//
+// Running N pairs at once can need N times the working set of the biggest
+// pair, more than the node has when several genome-scale pairs come up
+// together.  A MemoryBudget admits a pair only once its estimated working set
+// fits beside those of the pairs already running; a pair that does not fit
+// waits, and memory a finished pair frees goes to the waiting pairs first,
+// oldest first, so small pairs behind a big one fill in the space the big
+// one cannot use.  A waiting pair is never starved as long as the caller
+// bounds how far later pairs can overtake it: the manifest pipeline's ring
+// of buffers does, since records are written in order.  A working set larger
+// than the whole budget is charged as the whole budget, so it runs alone.
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <mutex>
+
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t bytes) : budget(bytes), inUse(0), peak(0), waits(0) {}
+
+    // Block until bytes fit; returns the bytes charged, to be released
+    size_t acquire(size_t bytes) {
+        bytes = std::min(bytes, budget);
+        std::unique_lock<std::mutex> lock(mutex);
+        if(inUse + bytes <= budget) {
+            charge(bytes);
+            return bytes;
+        }
+        Waiter w = { bytes, false };
+        waiting.push_back(&w);
+        waits++;
+        admitted.wait(lock, [&] { return w.admitted; });
+        return bytes;
+    }
+
+    void release(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        inUse -= bytes;
+        bool any = false;
+        for(auto it = waiting.begin(); it != waiting.end(); ) {
+            if(inUse + (*it)->bytes <= budget) {
+                charge((*it)->bytes);
+                (*it)->admitted = true;
+                it = waiting.erase(it);
+                any = true;
+            } else {
+                ++it;
+            }
+        }
+        if(any) admitted.notify_all();
+    }
+
+    size_t capacity() const { return budget; }
+    size_t peakBytes() const { return peak; }
+    long waitCount() const { return waits; }
+
+private:
+    struct Waiter {
+        size_t bytes;
+        bool admitted;
+    };
+
+    void charge(size_t bytes) {
+        inUse += bytes;
+        peak = std::max(peak, inUse);
+    }
+
+    const size_t budget;
+    size_t inUse;
+    size_t peak;
+    long waits;
+    std::list<Waiter *> waiting;        // oldest first
+    std::mutex mutex;
+    std::condition_variable admitted;
+};
+
+#endif // MEMORY_BUDGET_H
@@ -0,0 +1,115 @@
+// mergeShards.cpp - Combine the outputs of a sharded manifest run
+//
+// Each node runs cpuSmithWaterman -m <manifest> --shard i/N on its share of
+// the pairs.  This reads the shard outputs, archives with an index or plain
+// Pair: streams from stdout, in any order, and writes one archive with every
+// pair in manifest order, the same as an unsharded -o run would write.  Pairs
+// a --min-score run pruned keep their pruned records (see pairArchive.h) and
+// count as merged, not missing.
+//
+// Usage: mergeShards <manifest> <merged archive> <shard output> ...
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include "pairManifest.h"
+#include "pairArchive.h"
+
+struct ShardRecord {
+    size_t shard;
+    ArchiveEntry entry;
+};
+
+int main(int argc, char **argv) {
+    if(argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <manifest> <merged archive> <shard output> ...\n";
+        return 1;
+    }
+    PairManifest manifest;
+    std::string error;
+    if(!readManifest(argv[1], manifest, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    std::string mergedPath = argv[2];
+
+    // Find every record in the shard outputs
+    std::vector<std::string> shardPaths(argv + 3, argv + argc);
+    std::map<std::string, ShardRecord> records;
+    int duplicates = 0;
+    for(size_t s = 0; s < shardPaths.size(); ++s) {
+        std::vector<ArchiveEntry> entries;
+        if(!readArchiveIndex(shardPaths[s], entries) && !scanArchive(shardPaths[s], entries)) {
+            std::cerr << "Error: unable to read " << shardPaths[s] << "\n";
+            return 1;
+        }
+        for(const ArchiveEntry& e : entries) {
+            ShardRecord r = { s, e };
+            if(!records.insert(std::make_pair(e.label, r)).second) {
+                std::cerr << "Warning: " << e.label << " is in both " << shardPaths[records[e.label].shard]
+                          << " and " << shardPaths[s] << "\n";
+                duplicates++;
+            }
+        }
+    }
+
+    std::vector<std::ifstream> shards(shardPaths.size());
+    for(size_t s = 0; s < shardPaths.size(); ++s) {
+        shards[s].open(shardPaths[s], std::ios::binary);
+        if(!shards[s].is_open()) {
+            std::cerr << "Error: unable to read " << shardPaths[s] << "\n";
+            return 1;
+        }
+    }
+    ArchiveWriter merged;
+    if(!merged.open(mergedPath)) {
+        std::cerr << "Error: unable to create archive " << mergedPath << "\n";
+        return 1;
+    }
+
+    // Copy the records out in manifest order
+    std::string msf;
+    size_t copied = 0, pruned = 0;
+    int missing = 0;
+    for(const ManifestPair& pair : manifest.pairs) {
+        std::string label = pairLabel(manifest, pair);
+        auto it = records.find(label);
+        if(it == records.end()) {
+            std::cerr << "Warning: " << label << " is not in any shard\n";
+            missing++;
+            continue;
+        }
+        const ShardRecord& r = it->second;
+        if(r.entry.pruned()) {
+            if(!merged.appendPruned(manifest.families[pair.family].name, label)) {
+                std::cerr << "Error: unable to write to archive " << mergedPath << "\n";
+                return 1;
+            }
+            copied++;
+            pruned++;
+            continue;
+        }
+        if(!readArchiveRecord(shards[r.shard], r.entry, msf)) {
+            std::cerr << "Error: unable to read " << label << " from " << shardPaths[r.shard] << "\n";
+            return 1;
+        }
+        if(!merged.append(manifest.families[pair.family].name, label, msf)) {
+            std::cerr << "Error: unable to write to archive " << mergedPath << "\n";
+            return 1;
+        }
+        copied++;
+    }
+    if(!merged.close()) {
+        std::cerr << "Error: unable to write to archive " << mergedPath << "\n";
+        return 1;
+    }
+    if(copied < records.size()) {
+        std::cerr << "Warning: " << records.size() - copied << " records are not in " << argv[1] << "\n";
+    }
+    std::cerr << "Merged " << copied << " of " << manifest.pairs.size() << " pairs";
+    if(pruned) std::cerr << " (" << pruned << " pruned)";
+    std::cerr << " from " << shardPaths.size() << " shards into " << mergedPath << "\n";
+    return (missing || duplicates) ? 1 : 0;
+}
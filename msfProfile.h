@@ -0,0 +1,142 @@
+// msfProfile.h - Reading MSF alignments and building position-specific profiles
+//
+// A PSSM (position-specific scoring matrix) built from a reference MSF lets a
+// whole family be aligned against a candidate sequence: each profile column
+// scores a residue by how often the family has it there.  Sequences are
+// weighted by Henikoff's position-based scheme, so a cluster of near-identical
+// rows counts for little more than one of them.  A column keeps the pairwise
+// scoring's scale: it gives the match score expected against a residue drawn
+// from the column, mismatchScore + (matchScore - mismatchScore) * p, scaled by
+// PSSM_SCALE to keep it an integer; gaps are scaled the same way.  Columns
+// that are gaps in at least half of the weighted rows are insertions in a few
+// members and are left out of the profile.
+
+#ifndef MSF_PROFILE_H
+#define MSF_PROFILE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cctype>
+#include <cmath>
+
+// Read the gapped rows of an MSF alignment, in file order, '-' for gaps
+inline bool readMsfRows(const std::string& filename, std::vector<std::string>& names,
+                        std::vector<std::string>& rows) {
+    std::ifstream fin(filename);
+    if(!fin.is_open()) {
+        return false;
+    }
+    std::string line;
+    while(std::getline(fin, line)) {
+        if(line.compare(0, 2, "//") == 0) break;
+    }
+    std::map<std::string, size_t> index;
+    while(std::getline(fin, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if(start == std::string::npos) continue;
+        size_t end = line.find_first_of(" \t\r", start);
+        if(end == std::string::npos) continue;
+        std::string name = line.substr(start, end - start);
+        // skip column-number rulers
+        if(name.find_first_not_of("0123456789") == std::string::npos) continue;
+        if(!index.count(name)) {
+            index[name] = names.size();
+            names.push_back(name);
+            rows.push_back("");
+        }
+        std::string& row = rows[index[name]];
+        for(size_t k = end; k < line.size(); ++k) {
+            char c = line[k];
+            if(c == '.' || c == '~' || c == '-') row.push_back('-');
+            else if(isalpha(static_cast<unsigned char>(c)) || c == '*') row.push_back(c);
+        }
+    }
+    return !names.empty();
+}
+
+// Profile scores are this many times the pairwise scores
+const int PSSM_SCALE = 10;
+
+// Residue classes of a profile column: the 26 letters, then anything else
+const int PSSM_RESIDUES = 27;
+
+inline int pssmResidue(char c) {
+    int u = std::toupper(static_cast<unsigned char>(c));
+    return (u >= 'A' && u <= 'Z') ? u - 'A' : 26;
+}
+
+struct Pssm {
+    std::string consensus;        // most likely residue of each column
+    std::vector<int> scores;      // PSSM_RESIDUES scores per column
+    int gapScore;
+    int sequences;
+    int alignedColumns;           // columns of the MSF, before insertions are dropped
+
+    int score(int column, char residue) const {
+        return scores[column * PSSM_RESIDUES + pssmResidue(residue)];
+    }
+};
+
+// Henikoff position-based weights, summing to 1
+inline std::vector<double> henikoffWeights(const std::vector<std::string>& rows) {
+    std::vector<double> weights(rows.size(), 0.0);
+    size_t length = rows.empty() ? 0 : rows[0].size();
+    for(size_t c = 0; c < length; ++c) {
+        int counts[PSSM_RESIDUES] = {0};
+        int kinds = 0;
+        for(const std::string& row : rows) {
+            if(c >= row.size() || row[c] == '-') continue;
+            if(counts[pssmResidue(row[c])]++ == 0) kinds++;
+        }
+        if(kinds == 0) continue;
+        for(size_t s = 0; s < rows.size(); ++s) {
+            if(c >= rows[s].size() || rows[s][c] == '-') continue;
+            weights[s] += 1.0 / (kinds * counts[pssmResidue(rows[s][c])]);
+        }
+    }
+    double total = 0;
+    for(double w : weights) total += w;
+    for(double& w : weights) w = total > 0 ? w / total : 1.0 / rows.size();
+    return weights;
+}
+
+inline Pssm buildPssm(const std::vector<std::string>& rows,
+                      int matchScore, int mismatchScore, int gapScore) {
+    Pssm pssm;
+    pssm.gapScore = gapScore * PSSM_SCALE;
+    pssm.sequences = rows.size();
+    pssm.alignedColumns = rows.empty() ? 0 : rows[0].size();
+    std::vector<double> weights = henikoffWeights(rows);
+    for(int c = 0; c < pssm.alignedColumns; ++c) {
+        double mass[PSSM_RESIDUES] = {0};
+        double residues = 0;
+        for(size_t s = 0; s < rows.size(); ++s) {
+            if(c >= (int)rows[s].size() || rows[s][c] == '-') continue;
+            mass[pssmResidue(rows[s][c])] += weights[s];
+            residues += weights[s];
+        }
+        if(residues <= 0.5) continue;
+        int best = 0;
+        for(int a = 0; a < PSSM_RESIDUES; ++a) {
+            double p = mass[a] / residues;
+            pssm.scores.push_back((int)std::lround(PSSM_SCALE * (mismatchScore + (matchScore - mismatchScore) * p)));
+            if(mass[a] > mass[best]) best = a;
+        }
+        pssm.consensus.push_back(best < 26 ? 'A' + best : 'X');
+    }
+    return pssm;
+}
+
+// Build the profile of an MSF file; false if it cannot be read or has no
+// column kept
+inline bool loadMsfPssm(const std::string& filename, int matchScore, int mismatchScore,
+                        int gapScore, Pssm& pssm) {
+    std::vector<std::string> names, rows;
+    if(!readMsfRows(filename, names, rows)) return false;
+    pssm = buildPssm(rows, matchScore, mismatchScore, gapScore);
+    return !pssm.consensus.empty();
+}
+
+#endif // MSF_PROFILE_H
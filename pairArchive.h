@@ -0,0 +1,233 @@
+// pairArchive.h - Single-file result archives for multi-pair runs
+//
+// An archive holds the MSF output of every pair aligned in one run, in place
+// of one file per pair.  It is append-only: each record is the "Pair: <label>"
+// line followed by the pair's MSF text, exactly as the aligner prints it.
+// Alongside it, <archive>.idx gets one line per record as the record is
+// written:
+//
+//   <offset> <length> <family> <label>
+//
+// where offset and length give the byte range of the MSF text (without the
+// Pair: line).  Both files stay consistent if a run stops part way, and the
+// archive on its own can be re-indexed by scanning for Pair: lines.
+//
+// A pair a run with a minimum score gave up on still gets a record, with no
+// MSF text: its Pair: line is followed by the next one, and its index line has
+// length 0 and a trailing "pruned".  Readers count it as done and skipped, so
+// merges, scoring and resumed runs do not take it for a lost pair.
+//
+// The index doubles as the run's journal of completed pairs.  Both files are
+// fsynced every SYNC_BATCH records, and ArchiveWriter::resume reopens an
+// interrupted archive, cutting off anything after the last record the index
+// and the archive agree on.
+
+#ifndef PAIR_ARCHIVE_H
+#define PAIR_ARCHIVE_H
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+struct ArchiveEntry {
+    long offset;
+    long length;
+    std::string family;
+    std::string label;
+
+    bool pruned() const { return length == 0; }
+};
+
+inline std::string archiveIndexPath(const std::string& archivePath) {
+    return archivePath + ".idx";
+}
+
+// Read an archive's index
+inline bool readArchiveIndex(const std::string& archivePath, std::vector<ArchiveEntry>& entries) {
+    std::ifstream fin(archiveIndexPath(archivePath));
+    if(!fin.is_open()) return false;
+    entries.clear();
+    std::string line;
+    while(std::getline(fin, line)) {
+        std::istringstream in(line);
+        ArchiveEntry e;
+        if(in >> e.offset >> e.length >> e.family >> e.label) entries.push_back(e);
+    }
+    return true;
+}
+
+// Rebuild the index of an archive whose .idx file is missing.  The family is
+// taken to be the label up to its first underscore.
+inline bool scanArchive(const std::string& archivePath, std::vector<ArchiveEntry>& entries) {
+    std::ifstream fin(archivePath, std::ios::binary);
+    if(!fin.is_open()) return false;
+    entries.clear();
+    std::string line;
+    long pos = 0;
+    while(std::getline(fin, line)) {
+        long next = pos + (long)line.size() + (fin.eof() ? 0 : 1);
+        if(line.compare(0, 6, "Pair: ") == 0) {
+            if(!entries.empty()) entries.back().length = pos - entries.back().offset;
+            ArchiveEntry e;
+            e.label = line.substr(6);
+            e.family = e.label.substr(0, e.label.find('_'));
+            e.offset = next;
+            e.length = 0;
+            entries.push_back(e);
+        }
+        pos = next;
+    }
+    if(!entries.empty()) entries.back().length = pos - entries.back().offset;
+    return true;
+}
+
+// Read one record's MSF text
+inline bool readArchiveRecord(std::ifstream& archive, const ArchiveEntry& e, std::string& msf) {
+    msf.assign(e.length, '\0');
+    archive.clear();
+    archive.seekg(e.offset);
+    return e.length == 0 || static_cast<bool>(archive.read(&msf[0], e.length));
+}
+
+class ArchiveWriter {
+public:
+    static const int SYNC_BATCH = 32;
+
+    ArchiveWriter() : data(NULL), index(NULL), offset(0), pending(0) {}
+    ~ArchiveWriter() { close(); }
+
+    // Create (or truncate) the archive and its index
+    bool open(const std::string& path) {
+        close();
+        data = std::fopen(path.c_str(), "wb");
+        index = std::fopen(archiveIndexPath(path).c_str(), "w");
+        offset = 0;
+        pending = 0;
+        return data != NULL && index != NULL;
+    }
+
+    // Reopen the archive of an interrupted run for appending, keeping the
+    // records up to the first index line that is torn or does not match the
+    // archive, and return them in done.  Without an index, every record found
+    // by scanning is kept except the last, which may be torn.  A missing
+    // archive starts a new one.
+    bool resume(const std::string& path, std::vector<ArchiveEntry>& done) {
+        close();
+        done.clear();
+        std::string indexPath = archiveIndexPath(path);
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0) return open(path);
+        long size = (long)st.st_size;
+
+        std::ifstream fin(path, std::ios::binary);
+        std::ifstream idx(indexPath);
+        bool haveIndex = idx.is_open();
+        long end = 0, indexEnd = 0;
+        std::vector<ArchiveEntry> entries;
+        std::vector<long> lineEnds;
+        if(haveIndex) {
+            std::string line;
+            // a last line without its newline is torn
+            while(std::getline(idx, line) && !idx.eof()) {
+                std::istringstream in(line);
+                ArchiveEntry e;
+                if(!(in >> e.offset >> e.length >> e.family >> e.label)) break;
+                entries.push_back(e);
+                indexEnd += (long)line.size() + 1;
+                lineEnds.push_back(indexEnd);
+            }
+        } else if(scanArchive(path, entries) && !entries.empty()) {
+            entries.pop_back();
+        }
+        indexEnd = 0;
+        for(size_t k = 0; k < entries.size(); ++k) {
+            if(!validRecord(fin, entries[k], end, size)) break;
+            done.push_back(entries[k]);
+            end = entries[k].offset + entries[k].length;
+            if(haveIndex) indexEnd = lineEnds[k];
+        }
+        fin.close();
+        idx.close();
+
+        if(truncate(path.c_str(), end) != 0) return false;
+        if(haveIndex && truncate(indexPath.c_str(), indexEnd) != 0) return false;
+        data = std::fopen(path.c_str(), "ab");
+        index = std::fopen(indexPath.c_str(), haveIndex ? "a" : "w");
+        offset = end;
+        pending = 0;
+        if(data == NULL || index == NULL) return false;
+        if(!haveIndex) {
+            for(const ArchiveEntry& e : done) writeIndexLine(e.offset, e.length, e.family, e.label);
+        }
+        return sync();
+    }
+
+    // Append one pair's MSF text; the index line is written after the
+    // record so the index never points past the end of the archive
+    bool append(const std::string& family, const std::string& label, const std::string& msf) {
+        std::string header = "Pair: " + label + "\n";
+        if(std::fwrite(header.data(), 1, header.size(), data) != header.size() ||
+           std::fwrite(msf.data(), 1, msf.size(), data) != msf.size() ||
+           std::fflush(data) != 0) {
+            return false;
+        }
+        offset += (long)header.size();
+        writeIndexLine(offset, (long)msf.size(), family, label);
+        offset += (long)msf.size();
+        if(std::fflush(index) != 0) return false;
+        return ++pending < SYNC_BATCH || sync();
+    }
+
+    // Record a pair pruned below the run's minimum score
+    bool appendPruned(const std::string& family, const std::string& label) {
+        return append(family, label, "");
+    }
+
+    // Make the records written so far durable, archive before index
+    bool sync() {
+        pending = 0;
+        return std::fflush(data) == 0 && fsync(fileno(data)) == 0 &&
+               std::fflush(index) == 0 && fsync(fileno(index)) == 0;
+    }
+
+    bool close() {
+        bool ok = !data || !index || sync();
+        if(data && std::fclose(data) != 0) ok = false;
+        if(index && std::fclose(index) != 0) ok = false;
+        data = index = NULL;
+        return ok;
+    }
+
+private:
+    void writeIndexLine(long at, long length, const std::string& family, const std::string& label) {
+        std::fprintf(index, "%ld %ld %s %s%s\n", at, length, family.c_str(), label.c_str(),
+                     length == 0 ? " pruned" : "");
+    }
+
+    // Does e follow the record ending at end, with its Pair: line in place?
+    static bool validRecord(std::ifstream& fin, const ArchiveEntry& e, long end, long size) {
+        std::string header = "Pair: " + e.label + "\n";
+        if(e.offset - (long)header.size() != end || e.length < 0 || e.offset + e.length > size) {
+            return false;
+        }
+        std::string text(header.size(), '\0');
+        char last;
+        fin.clear();
+        fin.seekg(end);
+        if(!fin.read(&text[0], header.size()) || text != header) return false;
+        if(e.pruned()) return true;
+        fin.seekg(e.offset + e.length - 1);
+        return fin.get(last) && last == '\n';
+    }
+
+    std::FILE *data;
+    std::FILE *index;
+    long offset;
+    int pending;
+};
+
+#endif // PAIR_ARCHIVE_H
@@ -0,0 +1,200 @@
+// pairManifest.h - Pair manifests for batch alignment and scoring
+//
+// A manifest replaces the per-sequence FASTA files and per-pair MSF files
+// written by splitSequences.py and splitMSF.py.  It is plain text with one
+// record per line:
+//
+//   F <family> <tfa path> <msf path or ->
+//   S <name> <offset> <bytes> <length>
+//   P <name1> <name2> <reference>
+//
+// S and P records belong to the most recent F record.  An S record gives the
+// byte range of a sequence's residue lines in the family's .tfa file and its
+// residue count.  The reference of a P record is the family's reference
+// alignment projected onto the two sequences, as run-length operations:
+// M (residues from both), D (a residue from name1 only) and I (a residue from
+// name2 only), e.g. "3I42M2D".  Columns gapped in both are dropped.  A
+// reference of "-" means the family has no usable reference alignment.
+
+#ifndef PAIR_MANIFEST_H
+#define PAIR_MANIFEST_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+
+struct ManifestSequence {
+    std::string name;
+    long offset;
+    long bytes;
+    int length;
+};
+
+struct ManifestFamily {
+    std::string name;
+    std::string tfaPath;
+    std::string msfPath;
+    std::vector<ManifestSequence> seqs;
+};
+
+struct ManifestPair {
+    int family;
+    int seq1;
+    int seq2;
+    std::string reference;
+};
+
+struct PairManifest {
+    std::vector<ManifestFamily> families;
+    std::vector<ManifestPair> pairs;
+};
+
+// Label used for a pair in output records, matching the file names
+// splitMSF.py gives the pairwise reference MSFs
+inline std::string pairLabel(const PairManifest& manifest, const ManifestPair& pair) {
+    const ManifestFamily& fam = manifest.families[pair.family];
+    return fam.name + "_" + fam.seqs[pair.seq1].name + "__" + fam.seqs[pair.seq2].name;
+}
+
+inline int findManifestSequence(const ManifestFamily& fam, const std::string& name) {
+    for(size_t k = 0; k < fam.seqs.size(); ++k) {
+        if(fam.seqs[k].name == name) return (int)k;
+    }
+    return -1;
+}
+
+// Estimated cost of aligning a pair: the number of DP cells
+inline long long pairCost(const PairManifest& manifest, const ManifestPair& pair) {
+    const ManifestFamily& fam = manifest.families[pair.family];
+    return (long long)fam.seqs[pair.seq1].length * fam.seqs[pair.seq2].length + 1;
+}
+
+// Parse a shard specification "i/N" with 0 <= i < N
+inline bool parseShard(const std::string& spec, int& shard, int& nShards) {
+    size_t slash = spec.find('/');
+    if(slash == std::string::npos || slash == 0 || slash + 1 == spec.size()) return false;
+    if(spec.find_first_not_of("0123456789/") != std::string::npos) return false;
+    if(spec.find('/', slash + 1) != std::string::npos) return false;
+    shard = std::atoi(spec.substr(0, slash).c_str());
+    nShards = std::atoi(spec.substr(slash + 1).c_str());
+    return nShards > 0 && shard < nShards;
+}
+
+// Indices of the manifest pairs in shard i of N.  The pairs are taken in
+// manifest order, which walks each family's upper triangle of pairs (a, b),
+// a < b, row by row as splitPairs writes it, and cut into N contiguous ranges
+// of about equal estimated cost: a pair belongs to the shard its cost
+// midpoint falls in.  The split depends only on the manifest, so every node
+// computes the same one, and concatenating the shards in shard order gives
+// the manifest order back.
+inline std::vector<size_t> shardPairs(const PairManifest& manifest, int shard, int nShards) {
+    std::vector<size_t> selected;
+    long long total = 0;
+    for(const ManifestPair& pair : manifest.pairs) total += pairCost(manifest, pair);
+    long long before = 0;
+    for(size_t k = 0; k < manifest.pairs.size(); ++k) {
+        long long cost = pairCost(manifest, manifest.pairs[k]);
+        long long mid = 2 * before + cost;
+        int owner = (int)std::min<long long>(nShards - 1, mid * nShards / (2 * total));
+        if(owner == shard) selected.push_back(k);
+        before += cost;
+    }
+    return selected;
+}
+
+// Read a manifest; on failure return false with a message in error
+inline bool readManifest(const std::string& path, PairManifest& manifest, std::string& error) {
+    std::ifstream fin(path);
+    if(!fin.is_open()) {
+        error = "cannot open manifest " + path;
+        return false;
+    }
+    manifest.families.clear();
+    manifest.pairs.clear();
+
+    std::string line;
+    int lineNo = 0;
+    while(std::getline(fin, line)) {
+        ++lineNo;
+        if(line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        std::string tag;
+        in >> tag;
+        bool ok = true;
+        if(tag == "F") {
+            ManifestFamily fam;
+            ok = static_cast<bool>(in >> fam.name >> fam.tfaPath >> fam.msfPath);
+            if(fam.msfPath == "-") fam.msfPath.clear();
+            manifest.families.push_back(fam);
+        } else if(tag == "S" && !manifest.families.empty()) {
+            ManifestSequence s;
+            ok = static_cast<bool>(in >> s.name >> s.offset >> s.bytes >> s.length);
+            manifest.families.back().seqs.push_back(s);
+        } else if(tag == "P" && !manifest.families.empty()) {
+            ManifestPair pair;
+            std::string name1, name2;
+            ok = static_cast<bool>(in >> name1 >> name2 >> pair.reference);
+            pair.family = (int)manifest.families.size() - 1;
+            pair.seq1 = findManifestSequence(manifest.families.back(), name1);
+            pair.seq2 = findManifestSequence(manifest.families.back(), name2);
+            if(pair.reference == "-") pair.reference.clear();
+            ok = ok && pair.seq1 >= 0 && pair.seq2 >= 0;
+            manifest.pairs.push_back(pair);
+        } else {
+            ok = false;
+        }
+        if(!ok) {
+            error = path + ":" + std::to_string(lineNo) + ": malformed manifest record";
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void writeManifest(std::ostream& out, const PairManifest& manifest) {
+    out << "# pair manifest: F family tfa msf / S name offset bytes length / P name1 name2 reference\n";
+    for(size_t f = 0; f < manifest.families.size(); ++f) {
+        const ManifestFamily& fam = manifest.families[f];
+        out << "F " << fam.name << ' ' << fam.tfaPath << ' '
+            << (fam.msfPath.empty() ? "-" : fam.msfPath) << '\n';
+        for(const ManifestSequence& s : fam.seqs) {
+            out << "S " << s.name << ' ' << s.offset << ' ' << s.bytes << ' ' << s.length << '\n';
+        }
+        for(const ManifestPair& pair : manifest.pairs) {
+            if(pair.family != (int)f) continue;
+            out << "P " << fam.seqs[pair.seq1].name << ' ' << fam.seqs[pair.seq2].name << ' '
+                << (pair.reference.empty() ? "-" : pair.reference) << '\n';
+        }
+    }
+}
+
+// Read the residues of one sequence from its family's .tfa file
+inline bool loadManifestSequence(std::ifstream& tfa, const ManifestSequence& s, std::string& seq) {
+    std::string raw(s.bytes, '\0');
+    tfa.clear();
+    tfa.seekg(s.offset);
+    if(!tfa.read(&raw[0], s.bytes)) return false;
+    seq.clear();
+    seq.reserve(s.length);
+    for(char c : raw) {
+        if(!isspace(static_cast<unsigned char>(c))) seq.push_back(c);
+    }
+    return (int)seq.size() == s.length;
+}
+
+// Load every sequence of a family, in manifest order
+inline bool loadManifestFamily(const ManifestFamily& fam, std::vector<std::string>& seqs) {
+    std::ifstream tfa(fam.tfaPath, std::ios::binary);
+    if(!tfa.is_open()) return false;
+    seqs.assign(fam.seqs.size(), std::string());
+    for(size_t k = 0; k < fam.seqs.size(); ++k) {
+        if(!loadManifestSequence(tfa, fam.seqs[k], seqs[k])) return false;
+    }
+    return true;
+}
+
+#endif // PAIR_MANIFEST_H
@@ -0,0 +1,169 @@
+// progressiveAlign.h - Guide trees and profile alignment for family MSAs
+//
+// cpuSmithWaterman -M aligns a whole family at once: all-pairs scores give a
+// distance matrix, UPGMA turns it into a guide tree, and the sequences are
+// merged along the tree by aligning profiles, so each sequence is placed
+// against everything already aligned rather than against one other sequence.
+//
+// A profile is a set of gapped rows of equal length.  Two columns score the
+// average of the match/mismatch/gap scores over every pair of rows, one from
+// each column (gap against gap scores 0); profiles are aligned globally with
+// the same linear gap score as the pairwise aligner.
+
+#ifndef PROGRESSIVE_ALIGN_H
+#define PROGRESSIVE_ALIGN_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+struct GuideMerge {
+    int into;       // cluster that absorbs
+    int from;       // cluster that is absorbed
+};
+
+// UPGMA over a symmetric distance matrix, stored as a full n x n row-major
+// matrix and updated in place: O(n^2) memory, O(n^3) time.  Clusters are
+// named by their lowest-numbered remaining slot; returns the n - 1 merges in
+// order.
+inline std::vector<GuideMerge> upgmaGuideTree(std::vector<double>& dist, int n) {
+    std::vector<GuideMerge> merges;
+    std::vector<int> size(n, 1);
+    std::vector<bool> active(n, true);
+    for(int step = 1; step < n; ++step) {
+        int bi = -1, bj = -1;
+        double best = 0;
+        for(int i = 0; i < n; ++i) {
+            if(!active[i]) continue;
+            for(int j = i + 1; j < n; ++j) {
+                if(!active[j]) continue;
+                if(bi < 0 || dist[i * n + j] < best) {
+                    best = dist[i * n + j];
+                    bi = i;
+                    bj = j;
+                }
+            }
+        }
+        for(int k = 0; k < n; ++k) {
+            if(!active[k] || k == bi || k == bj) continue;
+            double d = (size[bi] * dist[bi * n + k] + size[bj] * dist[bj * n + k]) / (size[bi] + size[bj]);
+            dist[bi * n + k] = dist[k * n + bi] = d;
+        }
+        size[bi] += size[bj];
+        active[bj] = false;
+        merges.push_back(GuideMerge{bi, bj});
+    }
+    return merges;
+}
+
+// Gapped rows of some of the family's sequences
+struct Profile {
+    std::vector<int> members;           // sequence indices, in row order
+    std::vector<std::string> rows;      // '-' for gaps
+
+    size_t length() const { return rows.empty() ? 0 : rows[0].size(); }
+};
+
+// Residue counts of one profile column: 26 letters, anything else, gaps
+struct ProfileColumn {
+    int counts[27];
+    int residues;
+    int gaps;
+};
+
+inline std::vector<ProfileColumn> profileColumns(const Profile& p) {
+    std::vector<ProfileColumn> cols(p.length());
+    for(size_t c = 0; c < cols.size(); ++c) {
+        ProfileColumn& col = cols[c];
+        std::fill(col.counts, col.counts + 27, 0);
+        col.residues = col.gaps = 0;
+        for(const std::string& row : p.rows) {
+            unsigned char ch = row[c];
+            if(ch == '-') {
+                col.gaps++;
+                continue;
+            }
+            int u = std::toupper(ch);
+            col.counts[(u >= 'A' && u <= 'Z') ? u - 'A' : 26]++;
+            col.residues++;
+        }
+    }
+    return cols;
+}
+
+// Align two profiles globally and return the merged profile, rows of a
+// followed by rows of b
+inline Profile alignProfiles(const Profile& a, const Profile& b,
+                             int matchScore, int mismatchScore, int gapScore) {
+    std::vector<ProfileColumn> ca = profileColumns(a), cb = profileColumns(b);
+    int la = (int)ca.size(), lb = (int)cb.size();
+    double na = (double)a.rows.size(), nb = (double)b.rows.size();
+
+    // Cost of a column against a gap column in the other profile
+    std::vector<double> gapA(la + 1), gapB(lb + 1);
+    for(int i = 0; i < la; ++i) gapA[i + 1] = gapScore * ca[i].residues / na;
+    for(int j = 0; j < lb; ++j) gapB[j + 1] = gapScore * cb[j].residues / nb;
+
+    size_t rowCells = (size_t)lb + 1;
+    std::vector<double> score((la + 1) * rowCells);
+    std::vector<unsigned char> dir((la + 1) * rowCells);
+    score[0] = 0;
+    for(int j = 1; j <= lb; ++j) {
+        score[j] = score[j - 1] + gapB[j];
+        dir[j] = 3;
+    }
+    for(int i = 1; i <= la; ++i) {
+        score[i * rowCells] = score[(i - 1) * rowCells] + gapA[i];
+        dir[i * rowCells] = 2;
+    }
+    for(int i = 1; i <= la; ++i) {
+        const ProfileColumn& x = ca[i - 1];
+        for(int j = 1; j <= lb; ++j) {
+            const ProfileColumn& y = cb[j - 1];
+            long same = 0;
+            for(int k = 0; k < 27; ++k) same += (long)x.counts[k] * y.counts[k];
+            double pairScore = ((double)mismatchScore * x.residues * y.residues +
+                                (double)(matchScore - mismatchScore) * same +
+                                (double)gapScore * ((double)x.gaps * y.residues + (double)x.residues * y.gaps)) /
+                               (na * nb);
+            double diag = score[(i - 1) * rowCells + (j - 1)] + pairScore;
+            double up = score[(i - 1) * rowCells + j] + gapA[i];
+            double left = score[i * rowCells + (j - 1)] + gapB[j];
+            double best = diag;
+            unsigned char d = 1;
+            if(up > best) {
+                best = up;
+                d = 2;
+            }
+            if(left > best) {
+                best = left;
+                d = 3;
+            }
+            score[i * rowCells + j] = best;
+            dir[i * rowCells + j] = d;
+        }
+    }
+
+    // Traceback, building the merged rows backwards
+    Profile merged;
+    merged.members = a.members;
+    merged.members.insert(merged.members.end(), b.members.begin(), b.members.end());
+    merged.rows.assign(merged.members.size(), std::string());
+    int i = la, j = lb;
+    while(i > 0 || j > 0) {
+        unsigned char d = dir[i * rowCells + j];
+        for(size_t r = 0; r < a.rows.size(); ++r) {
+            merged.rows[r].push_back(d == 3 ? '-' : a.rows[r][i - 1]);
+        }
+        for(size_t r = 0; r < b.rows.size(); ++r) {
+            merged.rows[a.rows.size() + r].push_back(d == 2 ? '-' : b.rows[r][j - 1]);
+        }
+        if(d != 3) i--;
+        if(d != 2) j--;
+    }
+    for(std::string& row : merged.rows) std::reverse(row.begin(), row.end());
+    return merged;
+}
+
+#endif // PROGRESSIVE_ALIGN_H
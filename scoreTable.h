@@ -0,0 +1,98 @@
+// scoreTable.h - All-vs-all score table of a family, kept between runs
+//
+// cpuSmithWaterman --all-vs-all scores every pair of a family and saves the
+// scores with each sequence's content key (see sequenceDedup.h), so that when
+// the family grows only the pairs involving new or changed sequences are
+// aligned again: a pair whose two contents the saved table already scored,
+// in the same order and with the same scoring, keeps its score, whatever
+// the sequences are called now.  The table is plain text:
+//
+//   M <mode> <match> <mismatch> <gap>
+//   S <name> <fnv hash> <mix hash> <length>     one per sequence, in order
+//   P <i> <j> <score>                           one per pair, i < j
+//
+// Hashes are in hex; i and j number the S lines from 0.
+
+#ifndef SCORE_TABLE_H
+#define SCORE_TABLE_H
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "sequenceDedup.h"
+
+struct ScoreTable {
+    std::string scoring;                // mode and scores, as on the M line
+    std::vector<std::string> names;
+    std::vector<SequenceKey> keys;
+    std::vector<int> scores;            // n x n, row i < column j filled
+
+    size_t size() const { return names.size(); }
+    int score(size_t i, size_t j) const { return scores[i * names.size() + j]; }
+};
+
+// Read a score table; false, with the bad line number in badLine (0 if the
+// file cannot be opened), on error
+inline bool readScoreTable(const std::string& path, ScoreTable& table, int& badLine) {
+    std::ifstream fin(path);
+    badLine = 0;
+    if(!fin.is_open()) return false;
+    std::string line;
+    bool sized = false;
+    while(std::getline(fin, line)) {
+        badLine++;
+        if(line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        std::string tag;
+        in >> tag;
+        if(tag == "M" && table.scoring.empty()) {
+            std::getline(in >> std::ws, table.scoring);
+            if(table.scoring.empty()) return false;
+        } else if(tag == "S" && !sized) {
+            std::string name;
+            SequenceKey key;
+            if(!(in >> name >> std::hex >> key.fnv >> key.mix >> std::dec >> key.length)) return false;
+            table.names.push_back(name);
+            table.keys.push_back(key);
+        } else if(tag == "P") {
+            size_t n = table.names.size(), i, j;
+            if(!sized) table.scores.assign(n * n, 0);
+            sized = true;
+            int score;
+            if(!(in >> i >> j >> score) || i >= j || j >= n) return false;
+            table.scores[i * n + j] = score;
+        } else {
+            return false;
+        }
+    }
+    if(!sized) table.scores.assign(table.names.size() * table.names.size(), 0);
+    badLine = 0;
+    return !table.scoring.empty();
+}
+
+// Write the table beside path and rename it over path, so a failed write
+// leaves the previous table in place
+inline bool writeScoreTable(const std::string& path, const ScoreTable& table) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream fout(tmp);
+        fout << "# all-vs-all score table: M mode match mismatch gap / S name fnv mix length / P i j score\n";
+        fout << "M " << table.scoring << "\n";
+        for(size_t i = 0; i < table.size(); ++i) {
+            const SequenceKey& key = table.keys[i];
+            fout << "S " << table.names[i] << ' ' << std::hex << key.fnv << ' ' << key.mix << std::dec
+                 << ' ' << key.length << "\n";
+        }
+        for(size_t i = 0; i < table.size(); ++i) {
+            for(size_t j = i + 1; j < table.size(); ++j) {
+                fout << "P " << i << ' ' << j << ' ' << table.score(i, j) << "\n";
+            }
+        }
+        if(!fout) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+#endif // SCORE_TABLE_H
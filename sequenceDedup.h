@@ -0,0 +1,114 @@
+// sequenceDedup.h - Aligning each distinct pair of sequences once
+//
+// BAliBASE-derived collections hold many identical sequences under different
+// names, in one family and across families, and every duplicate would re-run
+// each alignment it takes part in.  Sequences are numbered by content after
+// upper-casing: two 64-bit hashes and the length make the key, so distinct
+// contents sharing a number would need both hashes to collide.  A run with
+// dedup plans which of its pairs are copies of an earlier pair, same first
+// sequence and same second, keeps the result of each first pair that has
+// copies until its last copy has been written with its own names, then
+// drops it.  Order matters, so A x B and B x A are distinct pairs: the glocal
+// mode is not symmetric, and ties in the others may resolve differently.
+
+#ifndef SEQUENCE_DEDUP_H
+#define SEQUENCE_DEDUP_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct SequenceKey {
+    uint64_t fnv;
+    uint64_t mix;
+    size_t length;
+
+    bool operator<(const SequenceKey& o) const {
+        if(fnv != o.fnv) return fnv < o.fnv;
+        if(mix != o.mix) return mix < o.mix;
+        return length < o.length;
+    }
+};
+
+inline SequenceKey sequenceKey(const std::string& seq) {
+    SequenceKey key = { 14695981039346656037ULL, 0x9e3779b97f4a7c15ULL, seq.size() };
+    for(unsigned char c : seq) {
+        key.fnv = (key.fnv ^ c) * 1099511628211ULL;
+        key.mix = (key.mix + c) * 0xbf58476d1ce4e5b9ULL;
+        key.mix ^= key.mix >> 31;
+    }
+    return key;
+}
+
+// Numbers distinct sequence contents in order of first appearance
+class SequenceIds {
+public:
+    int id(const std::string& seq) {
+        return ids.insert(std::make_pair(sequenceKey(seq), (int)ids.size())).first->second;
+    }
+    int count() const { return ids.size(); }
+
+private:
+    std::map<SequenceKey, int> ids;
+};
+
+// Which pairs of a run repeat an earlier one.  keys[k] holds the ids of the
+// k-th pair's two sequences, or -1 for a pair that must be aligned anyway.
+inline std::vector<size_t> firstOfPairs(const std::vector<std::pair<int, int>>& keys) {
+    std::map<std::pair<int, int>, size_t> seen;
+    std::vector<size_t> first(keys.size());
+    for(size_t k = 0; k < keys.size(); ++k) {
+        first[k] = k;
+        if(keys[k].first < 0 || keys[k].second < 0) continue;
+        first[k] = seen.insert(std::make_pair(keys[k], k)).first->second;
+    }
+    return first;
+}
+
+// An alignment kept for the copies of its pair
+struct PairResult {
+    std::string align1, align2;
+    int maxScore;
+    std::string error;
+};
+
+// The dedup plan of a run in progress; not thread-safe, callers that share
+// one hold a lock around it
+class DedupPlan {
+public:
+    void plan(const std::vector<std::pair<int, int>>& keys) {
+        first = firstOfPairs(keys);
+        copiesLeft.assign(keys.size(), 0);
+        for(size_t k = 0; k < first.size(); ++k) {
+            if(first[k] != k) copiesLeft[first[k]]++;
+        }
+    }
+
+    bool isCopy(size_t k) const { return first[k] != k; }
+    size_t firstOf(size_t k) const { return first[k]; }
+    bool hasCopies(size_t k) const { return copiesLeft[k] > 0; }
+
+    size_t saved() const {
+        size_t n = 0;
+        for(size_t k = 0; k < first.size(); ++k) n += first[k] != k;
+        return n;
+    }
+
+    // Keep the result of a first pair that has copies
+    void keep(size_t k, const PairResult& result) { kept[k] = result; }
+
+    // The result of copy k's first pair; call done(k) once it is written
+    const PairResult& resultFor(size_t k) { return kept[first[k]]; }
+    void done(size_t k) {
+        if(--copiesLeft[first[k]] == 0) kept.erase(first[k]);
+    }
+
+private:
+    std::vector<size_t> first;
+    std::vector<size_t> copiesLeft;
+    std::map<size_t, PairResult> kept;
+};
+
+#endif // SEQUENCE_DEDUP_H
@@ -0,0 +1,187 @@
+// splitPairs.cpp - Write a pair manifest for BAliBASE families
+//
+// Reads every .tfa file in a sequence directory, and the .msf reference of
+// the same family from a reference directory, once.  Instead of writing one
+// FASTA file per sequence and one MSF per pair (splitSequences.py and
+// splitMSF.py), it writes a single manifest describing every pair; see
+// pairManifest.h for the format.  cpuSmithWaterman -m and bali_score -m take
+// the manifest as input.
+//
+// Usage: splitPairs <Sequences dir> <MSFs dir> [manifest]
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <dirent.h>
+#include "pairManifest.h"
+#include "msfProfile.h"
+
+// List the files in dir with the given extension (case-insensitive), sorted
+std::vector<std::string> listFiles(const std::string& dir, const std::string& ext) {
+    std::vector<std::string> names;
+    DIR *d = opendir(dir.c_str());
+    if(!d) return names;
+    while(struct dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if(name.size() <= ext.size()) continue;
+        std::string tail = name.substr(name.size() - ext.size());
+        std::transform(tail.begin(), tail.end(), tail.begin(), ::tolower);
+        if(tail == ext) names.push_back(name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::string absolutePath(const std::string& path) {
+    char buf[PATH_MAX];
+    if(realpath(path.c_str(), buf)) return buf;
+    return path;
+}
+
+// Index the sequences of a multi-FASTA (.tfa) file by byte range
+bool indexTfaFile(const std::string& filename, ManifestFamily& fam) {
+    std::ifstream fin(filename, std::ios::binary);
+    if(!fin.is_open()) {
+        return false;
+    }
+    std::string line;
+    long pos = 0;
+    ManifestSequence *cur = NULL;
+    while(std::getline(fin, line)) {
+        // getline sets eof only when the last line has no newline
+        long next = pos + (long)line.size() + (fin.eof() ? 0 : 1);
+        if(!line.empty() && line[0] == '>') {
+            ManifestSequence s;
+            size_t k = 1;
+            while(k < line.size() && !isspace(static_cast<unsigned char>(line[k]))) {
+                s.name.push_back(line[k]);
+                k++;
+            }
+            s.offset = next;
+            s.bytes = 0;
+            s.length = 0;
+            fam.seqs.push_back(s);
+            cur = &fam.seqs.back();
+        } else if(cur) {
+            for(char c : line) {
+                if(!isspace(static_cast<unsigned char>(c))) cur->length++;
+            }
+            cur->bytes = next - cur->offset;
+        }
+        pos = next;
+    }
+    return true;
+}
+
+// Project two reference rows onto a run-length M/D/I string
+std::string projectReference(const std::string& row1, const std::string& row2) {
+    std::string ops;
+    char last = 0;
+    int run = 0;
+    size_t len = std::min(row1.size(), row2.size());
+    for(size_t k = 0; k <= len; ++k) {
+        char op = 0;
+        if(k < len) {
+            bool r1 = row1[k] != '-';
+            bool r2 = row2[k] != '-';
+            if(!r1 && !r2) continue;
+            op = r1 && r2 ? 'M' : (r1 ? 'D' : 'I');
+        }
+        if(op == last) {
+            run++;
+            continue;
+        }
+        if(run > 0) ops += std::to_string(run) + last;
+        last = op;
+        run = 1;
+    }
+    return ops;
+}
+
+int residueCount(const std::string& row) {
+    return (int)std::count_if(row.begin(), row.end(), [](char c) { return c != '-'; });
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <Sequences dir> <MSFs dir> [manifest]\n";
+        return 1;
+    }
+    std::string seqDir = argv[1];
+    std::string msfDir = argv[2];
+
+    PairManifest manifest;
+    int missingRefs = 0;
+    for(const std::string& fname : listFiles(seqDir, ".tfa")) {
+        ManifestFamily fam;
+        fam.name = fname.substr(0, fname.size() - 4);
+        fam.tfaPath = absolutePath(seqDir + "/" + fname);
+        if(!indexTfaFile(fam.tfaPath, fam)) {
+            std::cerr << "Error: unable to read " << fam.tfaPath << "\n";
+            return 1;
+        }
+        int f = (int)manifest.families.size();
+
+        // Pair sequences in reference row order, as splitMSF.py does
+        std::vector<std::string> names, rows;
+        std::string msfPath = absolutePath(msfDir + "/" + fam.name + ".msf");
+        bool haveRef = readMsfRows(msfPath, names, rows);
+        if(haveRef) {
+            fam.msfPath = msfPath;
+        } else {
+            for(const ManifestSequence& s : fam.seqs) names.push_back(s.name);
+            rows.assign(names.size(), "");
+            missingRefs++;
+        }
+        manifest.families.push_back(fam);
+
+        for(size_t a = 0; a < names.size(); ++a) {
+            for(size_t b = a + 1; b < names.size(); ++b) {
+                ManifestPair pair;
+                pair.family = f;
+                pair.seq1 = findManifestSequence(fam, names[a]);
+                pair.seq2 = findManifestSequence(fam, names[b]);
+                if(pair.seq1 < 0 || pair.seq2 < 0) {
+                    std::cerr << "Warning: " << fam.name << ": " << (pair.seq1 < 0 ? names[a] : names[b])
+                              << " is in the reference but not in " << fam.tfaPath << "\n";
+                    continue;
+                }
+                if(haveRef) {
+                    if(residueCount(rows[a]) != fam.seqs[pair.seq1].length ||
+                       residueCount(rows[b]) != fam.seqs[pair.seq2].length) {
+                        std::cerr << "Warning: " << fam.name << ": reference rows for " << names[a]
+                                  << " and " << names[b] << " do not match the sequences\n";
+                    } else {
+                        pair.reference = projectReference(rows[a], rows[b]);
+                    }
+                }
+                manifest.pairs.push_back(pair);
+            }
+        }
+    }
+    if(manifest.families.empty()) {
+        std::cerr << "Error: no .tfa files in " << seqDir << "\n";
+        return 1;
+    }
+
+    if(argc > 3) {
+        std::ofstream out(argv[3]);
+        if(!out.is_open()) {
+            std::cerr << "Error: unable to write " << argv[3] << "\n";
+            return 1;
+        }
+        writeManifest(out, manifest);
+    } else {
+        writeManifest(std::cout, manifest);
+    }
+    std::cerr << manifest.families.size() << " families, " << manifest.pairs.size() << " pairs";
+    if(missingRefs) std::cerr << " (" << missingRefs << " families without a reference)";
+    std::cerr << "\n";
+    return 0;
+}
@@ -0,0 +1,100 @@
+// swClient.cpp - Send pairs to a running alignment server
+//
+// Connects to cpuSmithWaterman -s <socket> (see alignProtocol.h), sends each
+// pair of FASTA files as one request, and prints the MSF alignment as the
+// two-file mode would, or with -s just the score.  The round-trip time of
+// each request goes to stderr.
+//
+// Usage: swClient <socket> [-s] <seq1.fasta> <seq2.fasta> [<seq1.fasta> <seq2.fasta> ...]
+//        swClient <socket> --stop
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "alignProtocol.h"
+
+int connectTo(const std::string& socketPath) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(addr.sun_path)) return -1;
+    std::strcpy(addr.sun_path, socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd >= 0 && connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool readWholeFile(const std::string& filename, std::string& text) {
+    std::ifstream fin(filename, std::ios::binary);
+    if(!fin.is_open()) return false;
+    std::ostringstream buf;
+    buf << fin.rdbuf();
+    text = buf.str();
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool scoreOnly = argc > 2 && std::string(argv[2]) == "-s";
+    int first = scoreOnly ? 3 : 2;
+    bool stop = argc == 3 && std::string(argv[2]) == "--stop";
+    if(!stop && (argc - first < 2 || (argc - first) % 2 != 0)) {
+        std::cerr << "Usage: " << argv[0] << " <socket> [-s] <seq1.fasta> <seq2.fasta> [<seq1.fasta> <seq2.fasta> ...]\n";
+        std::cerr << "       " << argv[0] << " <socket> --stop\n";
+        return 1;
+    }
+    int fd = connectTo(argv[1]);
+    if(fd < 0) {
+        std::cerr << "Error: unable to connect to " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> response;
+    if(stop) {
+        bool ok = writeFrame(fd, {"STOP"}) && readFrame(fd, response) && !response.empty() && response[0] == "OK";
+        close(fd);
+        return ok ? 0 : 1;
+    }
+
+    int failures = 0;
+    for(int a = first; a + 1 < argc; a += 2) {
+        std::string fasta1, fasta2;
+        if(!readWholeFile(argv[a], fasta1) || !readWholeFile(argv[a + 1], fasta2)) {
+            std::cerr << "Error: unable to read " << argv[a] << " or " << argv[a + 1] << "\n";
+            failures++;
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        if(!writeFrame(fd, {scoreOnly ? "SCORE" : "ALIGN", argv[a], fasta1, argv[a + 1], fasta2}) ||
+           !readFrame(fd, response) || response.empty()) {
+            std::cerr << "Error: lost connection to " << argv[1] << "\n";
+            close(fd);
+            return 1;
+        }
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if(response[0] != "OK" || response.size() < 2) {
+            std::cerr << "Error: " << argv[a] << " " << argv[a + 1] << ": "
+                      << (response.size() > 1 ? response[1] : "bad response") << "\n";
+            failures++;
+            continue;
+        }
+        if(scoreOnly) {
+            std::cout << argv[a] << " " << argv[a + 1] << " " << response[1] << "\n";
+        } else if(response.size() > 2) {
+            std::cout << response[2];
+        }
+        std::cerr << "Round trip: " << micros << " μs\n";
+    }
+    close(fd);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+#!/bin/bash
+# prunedPairs.sh - Shard, merge, score and resume a --min-score manifest run
+#
+# Pairs a run prunes below --min-score get pruned records (see pairArchive.h)
+# so the tools downstream count them as done and skipped.  This builds the
+# aligner, splitPairs, mergeShards and bali_score in a scratch directory, then
+# runs a manifest of the repository's families in two shards with a minimum
+# score and checks that merging them gives the archive an unsharded run
+# writes, that bali_score -m scores it without missing pairs, and that
+# resuming a shard, whole or cut short, aligns no pruned pair again.
+#
+# Usage: tests/prunedPairs.sh        (from the repository root)
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+repo=$(pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+failures=0
+
+check() {
+    if [ "$1" -eq 0 ]; then
+        echo -e "${GREEN}ok${NC}   $2"
+    else
+        echo -e "${RED}FAIL${NC} $2"
+        failures=$((failures + 1))
+    fi
+}
+
+# Build
+for src in cpuSmithWaterman splitPairs mergeShards; do
+    g++ -O3 -std=c++11 -pthread -o "$work/$src" "$repo/$src.cpp" || exit 1
+done
+for src in init util bali_score readmanifest xmlstub; do
+    cc -std=c99 -O2 -DGCG -I"$repo/bali_score_src" -c "$repo/bali_score_src/$src.c" -o "$work/$src.o" || exit 1
+done
+cc -o "$work/bali_score" "$work"/init.o "$work"/util.o "$work"/bali_score.o "$work"/readmanifest.o \
+    "$work"/xmlstub.o -lm 2>/dev/null || exit 1
+
+cd "$work" || exit 1
+./splitPairs "$repo/Sequences" "$repo/MSFs" pairs.manifest 2>/dev/null || exit 1
+
+# The unsharded run the others are compared with
+./cpuSmithWaterman -m pairs.manifest -o full.arc --min-score 20 2>/dev/null
+pruned=$(grep -c ' pruned$' full.arc.idx)
+total=$(wc -l < full.arc.idx)
+[ "$pruned" -gt 0 ] && [ "$pruned" -lt "$total" ]
+check $? "unsharded run prunes $pruned of $total pairs and records them"
+
+# Shards, to archives and to stdout, merged
+for i in 0 1; do
+    ./cpuSmithWaterman -m pairs.manifest -o s$i.arc --shard $i/2 --min-score 20 2>/dev/null
+    ./cpuSmithWaterman -m pairs.manifest --shard $i/2 --min-score 20 > s$i.txt 2>/dev/null
+done
+./mergeShards pairs.manifest merged.arc s0.arc s1.arc 2>merge.err
+check $? "mergeShards finds every pair in the shard archives"
+cmp -s merged.arc full.arc && cmp -s merged.arc.idx full.arc.idx
+check $? "merged archive is the unsharded one"
+./mergeShards pairs.manifest streams.arc s0.txt s1.txt 2>/dev/null && cmp -s streams.arc full.arc
+check $? "shard streams from stdout merge to the same archive"
+
+# Scoring
+./bali_score -m pairs.manifest merged.arc > scores.txt 2>scores.err
+check $? "bali_score -m skips the pruned pairs without failing"
+grep -q "$pruned pruned" scores.err
+check $? "bali_score -m reports $pruned pruned pairs"
+
+# Resuming a finished shard, then one cut short
+cp s0.arc r.arc
+cp s0.arc.idx r.arc.idx
+./cpuSmithWaterman -m pairs.manifest -o r.arc --shard 0/2 --resume --min-score 20 2>resume.err
+grep -q "Min score 20: 0 of 0 pairs" resume.err && cmp -s r.arc s0.arc && cmp -s r.arc.idx s0.arc.idx
+check $? "resuming a finished shard aligns nothing again"
+head -n $(( $(wc -l < s0.arc.idx) / 2 )) s0.arc.idx > r.arc.idx
+./cpuSmithWaterman -m pairs.manifest -o r.arc --shard 0/2 --resume --min-score 20 2>/dev/null
+cmp -s r.arc s0.arc && cmp -s r.arc.idx s0.arc.idx
+check $? "resuming a shard cut short completes it as one run would"
+
+if [ $failures -ne 0 ]; then
+    echo -e "${RED}$failures checks failed${NC}"
+    exit 1
+fi
+echo -e "${GREEN}All checks passed${NC}"
@@ -0,0 +1,103 @@
+// threadPlacement.h - Pinning worker threads to cores and NUMA nodes
+//
+// The node layout comes from /sys/devices/system/node, restricted to the
+// CPUs this process may run on.  A machine without that directory, or with a
+// single node, is treated as one node holding every allowed CPU, so the same
+// options work everywhere.  Memory is placed by Linux's first-touch policy:
+// a thread that is pinned before it allocates and fills its buffers gets them
+// on its own node, so no NUMA library is needed.
+
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <sched.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct CpuTopology {
+    std::vector<int> nodeIds;                  // nodes with any allowed CPU
+    std::vector<std::vector<int>> nodeCpus;    // and their allowed CPUs
+    std::vector<int> cpuNode;                  // index into nodeIds, by CPU number
+};
+
+// Parse a kernel CPU list such as "0-3,8-11"
+inline std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::istringstream in(text);
+    std::string range;
+    while(std::getline(in, range, ',')) {
+        int lo, hi;
+        int n = std::sscanf(range.c_str(), "%d-%d", &lo, &hi);
+        if(n == 1) hi = lo;
+        if(n < 1 || hi < lo) continue;
+        for(int c = lo; c <= hi; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+inline std::string readFirstLine(const std::string& path) {
+    std::ifstream fin(path);
+    std::string line;
+    std::getline(fin, line);
+    return line;
+}
+
+inline CpuTopology readCpuTopology() {
+    CpuTopology topo;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_SET(0, &allowed);
+    }
+    std::string sysNode = "/sys/devices/system/node/";
+    for(int node : parseCpuList(readFirstLine(sysNode + "online"))) {
+        std::vector<int> cpus;
+        for(int c : parseCpuList(readFirstLine(sysNode + "node" + std::to_string(node) + "/cpulist"))) {
+            if(c < CPU_SETSIZE && CPU_ISSET(c, &allowed)) cpus.push_back(c);
+        }
+        if(cpus.empty()) continue;
+        topo.nodeIds.push_back(node);
+        topo.nodeCpus.push_back(cpus);
+    }
+    if(topo.nodeCpus.empty()) {
+        std::vector<int> cpus;
+        for(int c = 0; c < CPU_SETSIZE; ++c) {
+            if(CPU_ISSET(c, &allowed)) cpus.push_back(c);
+        }
+        topo.nodeIds.push_back(0);
+        topo.nodeCpus.push_back(cpus);
+    }
+    for(size_t n = 0; n < topo.nodeCpus.size(); ++n) {
+        for(int c : topo.nodeCpus[n]) {
+            if((int)topo.cpuNode.size() <= c) topo.cpuNode.resize(c + 1, -1);
+            topo.cpuNode[c] = (int)n;
+        }
+    }
+    return topo;
+}
+
+// CPU for the k-th pinned worker: workers are dealt to the nodes in turn, and
+// take the cores of their node in order, wrapping when there are more workers
+// than cores
+inline int placementCpu(const CpuTopology& topo, int worker) {
+    const std::vector<int>& cpus = topo.nodeCpus[worker % topo.nodeCpus.size()];
+    return cpus[(worker / topo.nodeCpus.size()) % cpus.size()];
+}
+
+// Index into nodeIds of the node a CPU belongs to
+inline int cpuNodeOf(const CpuTopology& topo, int cpu) {
+    return cpu >= 0 && cpu < (int)topo.cpuNode.size() && topo.cpuNode[cpu] >= 0 ? topo.cpuNode[cpu] : 0;
+}
+
+// Pin the calling thread to one CPU
+inline bool pinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#endif // THREAD_PLACEMENT_H
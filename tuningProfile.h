@@ -0,0 +1,95 @@
+// tuningProfile.h - Fastest alignment engine per alphabet and pair size
+//
+// cpuSmithWaterman --autotune times each engine on pairs of growing length
+// on this machine and writes the winners as a tuning profile; a run given
+// --tuning <profile> then sends each pair to the engine its profile line
+// chose.  The profile is plain text, one rule per line:
+//
+//   <dna|protein|general> <max cells> <general|alphabet|out-of-core> [<tile bytes>]
+//
+// A pair of len1 x len2 cells takes the first rule of its alphabet with
+// max cells >= len1 * len2; a pair no rule covers keeps the default engine.
+
+#ifndef TUNING_PROFILE_H
+#define TUNING_PROFILE_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "alphabetKernels.h"
+
+enum TunedEngine { GENERAL_ENGINE, ALPHABET_ENGINE, OUT_OF_CORE_ENGINE };
+
+const char *const ALPHABET_NAMES[] = { "dna", "protein", "general" };
+const char *const ENGINE_NAMES[] = { "general", "alphabet", "out-of-core" };
+
+struct TuningRule {
+    SequenceAlphabet alphabet;
+    long long maxCells;
+    TunedEngine engine;
+    size_t tileBytes;           // out-of-core only
+};
+
+template <typename T>
+bool parseName(const std::string& name, const char *const names[], int count, T& value) {
+    for(int k = 0; k < count; ++k) {
+        if(name == names[k]) {
+            value = static_cast<T>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+struct TuningProfile {
+    std::vector<TuningRule> rules;
+
+    const TuningRule *lookup(SequenceAlphabet alphabet, long long cells) const {
+        for(const TuningRule& rule : rules) {
+            if(rule.alphabet == alphabet && cells <= rule.maxCells) return &rule;
+        }
+        return NULL;
+    }
+};
+
+// Read a tuning profile; false, with the bad line number in badLine (0 if
+// the file cannot be opened), on error
+inline bool readTuningProfile(const std::string& path, TuningProfile& profile, int& badLine) {
+    std::ifstream fin(path);
+    badLine = 0;
+    if(!fin.is_open()) return false;
+    std::string line;
+    while(std::getline(fin, line)) {
+        badLine++;
+        if(line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        std::string alphabet, engine;
+        TuningRule rule;
+        rule.tileBytes = 0;
+        if(!(in >> alphabet >> rule.maxCells >> engine) ||
+           !parseName(alphabet, ALPHABET_NAMES, 3, rule.alphabet) ||
+           !parseName(engine, ENGINE_NAMES, 3, rule.engine) ||
+           (rule.engine == OUT_OF_CORE_ENGINE && !(in >> rule.tileBytes))) {
+            return false;
+        }
+        profile.rules.push_back(rule);
+    }
+    badLine = 0;
+    return true;
+}
+
+inline bool writeTuningProfile(const std::string& path, const TuningProfile& profile,
+                               const std::string& comment) {
+    std::ofstream fout(path);
+    fout << "# tuning profile: alphabet max-cells engine [tile bytes]\n";
+    fout << "# " << comment << "\n";
+    for(const TuningRule& rule : profile.rules) {
+        fout << ALPHABET_NAMES[rule.alphabet] << ' ' << rule.maxCells << ' ' << ENGINE_NAMES[rule.engine];
+        if(rule.engine == OUT_OF_CORE_ENGINE) fout << ' ' << rule.tileBytes;
+        fout << '\n';
+    }
+    return static_cast<bool>(fout);
+}
+
+#endif // TUNING_PROFILE_H